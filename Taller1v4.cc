@@ -18,8 +18,31 @@
  * Los analisis y la documentación elaborada se encuentran disponibles en los demas archivos adjuntos.
  */
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <ctime>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <numeric>
+#include <random>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <queue>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
@@ -30,8 +53,10 @@
 #include "ns3/ssid.h"
 #include "ns3/applications-module.h"
 #include "ns3/yans-wifi-helper.h"
+#include "ns3/wifi-module.h"
 #include "ns3/point-to-point-helper.h"
 #include "ns3/stats-module.h"
+#include "ns3/traffic-control-module.h"
 
 using namespace ns3;
 
@@ -42,8 +67,196 @@ struct SimulationResult
     // useful for saving simulation statistics and useful data
     double throughput;
     double lossRate;
+
+    // Received packets over sent packets
+    double deliveryRatio = 0;
+
+    // Number of scheduler events executed during the run
+    uint64_t eventCount = 0;
+
+    // Peak resident memory of the process (KiB) over the run
+    long memoryKb = 0;
+
+    // Further statistics, saved as "group.name" -> value
+    std::map<std::string, double> stats;
+
+    // Run didn't finish (child process crashed), nothing else is valid
+    bool failed = false;
+
+    // Run was stopped early by EarlyStopMonitor (rates are over the time simulated)
+    bool truncated = false;
+
+    // Taken from cacheDir instead of running (so it's saved already)
+    bool cached = false;
+};
+
+// A row of a ResultStore, numeric and text columns by name
+struct ResultRow
+{
+    std::map<std::string, double> numbers;
+    std::map<std::string, std::string> texts;
+};
+
+// Every row of a ResultStore, column by column
+// Missing numbers are NaN and missing texts are empty
+struct ResultTable
+{
+    uint64_t nRows = 0;
+    std::map<std::string, std::vector<double>> numbers;
+    std::map<std::string, std::vector<std::string>> texts;
+};
+
+// Append-only columnar file of results
+// Each append writes a row group holding its own schema (so runs may add columns) with
+// the values of every column stored together. Groups are written with a single write
+// under an exclusive lock on a file opened with O_APPEND, so any number of processes can
+// share a file. A group cut by a crash is skipped when reading
+// Sweeps add rows as runs finish, they are appended in groups of up to GROUP_ROWS (so the
+// schema isn't repeated every row). Details of those rows are appended along with them
+class ResultStore
+{
+public:
+    explicit ResultStore(std::string);
+
+    // Append rows still waiting
+    ~ResultStore();
+
+    // Append rows as a single group
+    void append(const std::vector<ResultRow> &);
+
+    // Keep a row to append with others (appended once GROUP_ROWS are waiting)
+    void add(const ResultRow &);
+
+    // Append rows waiting as a single group
+    void flush();
+
+    // Store with details of the rows added here, it appends only when this one does (just
+    // before, so a crash in between leaves details of runs that are saved again on resume)
+    void attachDetails(ResultStore &);
+
+    // Read every group
+    ResultTable load() const;
+
+    // Run ids (runId column) of every row
+    std::set<std::string> runIds() const;
+
+    // Write every row as CSV (columns sorted by name, numbers first)
+    void exportCsv(std::string) const;
+
+    static const uint32_t GROUP_ROWS = 256;
+
+private:
+    std::string path;
+
+    // Rows added and not appended yet
+    std::vector<ResultRow> pending;
+
+    // Details store attached to this one, and store this one is attached to
+    ResultStore *detailsStore = NULL, *rowsStore = NULL;
+};
+
+// Journal of a sweep, so it can go on where it stopped after a crash
+// Each case is written as PLAN (its parameters) before running and DONE (its results)
+// after, every line ending with a checksum and synced to disk before going on. A line
+// cut by a crash is dropped when the journal is opened again
+class SweepJournal
+{
+public:
+    // Open journal, reading what an earlier run left
+    explicit SweepJournal(std::string);
+    ~SweepJournal();
+
+    // Identifies this sweep in saved results
+    std::string sweepId;
+
+    // Cases planned and finished so far (by case index)
+    std::map<uint32_t, std::vector<double>> planned;
+    std::map<uint32_t, SimulationResult> done;
+
+    // Record case parameters before running it
+    void plan(uint32_t, const std::vector<double> &);
+
+    // Record case results
+    void complete(uint32_t, const SimulationResult &);
+
+private:
+    int fd;
+
+    // Append line with its checksum and sync
+    void writeLine(std::string);
+};
+
+// Running histogram with power of two buckets, constant memory and cost per value
+struct Log2Histogram
+{
+    // Bucket 0 holds values below 1, bucket b values in [2^(b-1), 2^b)
+    static const int nBuckets = 48;
+    uint64_t buckets[nBuckets] = {};
+
+    uint64_t count = 0;
+    double sum = 0, max = 0;
+
+    void add(double);
+    double mean() const;
+
+    // Add every value of another histogram
+    void merge(const Log2Histogram &);
+
+    // Upper bound of the bucket holding the quantile
+    double quantile(double) const;
+};
+
+// Byte tag with the traffic class of a flow packet and the time it was sent
+// Classes are the wifi access categories. The top three bits of their ToS are a user
+// priority of the category, as QoS wifi devices take priority from ToS >> 5 on every hop
+// (WifiHelper selects their queues by DS field, as in the wifi-ac-mapping example)
+class FlowClassTag : public Tag
+{
+public:
+    enum Class
+    {
+        BE,
+        BK,
+        VI,
+        VO,
+        N_CLASSES
+    };
+
+    static const char *classNames[N_CLASSES];
+    static const uint8_t classTos[N_CLASSES];
+
+    // Class of a name (be, bk, vi, vo), N_CLASSES if unknown
+    static int fromName(std::string);
+
+    // Class of a ToS (by user priority, be if no class has it)
+    static uint8_t fromTos(uint8_t);
+
+    uint8_t flowClass = BE;
+    int64_t sendTime = 0; // Time steps
+
+    FlowClassTag() {}
+    FlowClassTag(uint8_t, Time);
+
+    // Mark a packet about to be sent with a class (this tag, ToS and priority)
+    // Class goes first, so it can be bound to a Tx trace
+    static void mark(uint8_t, Ptr<const Packet>);
+
+    // Give the socket of an OnOffApplication ToS and priority of a class (its packets are
+    // only passed to Tx once sent)
+    static void markSocket(uint8_t, Ptr<OnOffApplication>);
+
+    static TypeId GetTypeId();
+    TypeId GetInstanceTypeId() const override;
+    uint32_t GetSerializedSize() const override;
+    void Serialize(TagBuffer) const override;
+    void Deserialize(TagBuffer) override;
+    void Print(std::ostream &) const override;
 };
 
+class FlowSink;
+struct PhyProfile;
+struct BackboneProfile;
+
 // Define main class (Architecture)
 class Taller1Experiment
 {
@@ -79,12 +292,40 @@ public:
 
     int receivedCount = 0; // Packets
     int sentCount = 0;     // Packets
+    uint64_t receivedBytes = 0;
+
+    // Packets received by half of the run
+    int halfTimeReceived = 0;
+    void markHalfTime();
+
+    // Counters of a traffic class (see FlowClassTag)
+    struct ClassCounters
+    {
+        uint64_t sent = 0, received = 0, bytes = 0;
+        Log2Histogram latencyUs;
+
+        // Packets that reached the wifi queue of another access category
+        uint64_t misqueued = 0;
+    };
+
+    // Counters by traffic class
+    ClassCounters flowClasses[FlowClassTag::N_CLASSES];
+
+    // Packets received, by early stop interval they were sent in (see EarlyStopMonitor)
+    std::vector<uint64_t> receivedBySendInterval;
+
+    // Receiving side of flows, one per receiver node (by node id)
+    std::map<uint32_t, std::shared_ptr<FlowSink>> sinks;
+
+    // Get sink of a node, creating it the first time
+    FlowSink &getSink(Ptr<Node>);
 
     // Second layer resources
     // Note they aren't calculated with OnOffModel
     // Its just the datarate value for shared wifi channel
     // Note also this is represented by a String which match a
     // well-known datarate value denotated as a string
+    // (it is the default mode of the second level PhyProfile, see phyProfile2)
 
     // Valueas which can be used:
     // OfdmRate6Mbps
@@ -130,8 +371,256 @@ public:
     // Traffic ratio for nodes
     double trafficRatio = 0.99;
 
+    // Application used for flows
+    // multiflow: a MultiFlowOnOffApplication per node
+    // onoff: an OnOffApplication per flow
+    std::string trafficApplication = "multiflow";
+
+    // Traffic matrix (see TrafficMatrix)
+    // Model used to generate flows (uniform, gravity, hotspot)
+    std::string trafficModel = "uniform";
+
+    // Number of flows to generate
+    int nFlows = 20;
+
+    // Portion of flows staying inside their cluster (negative means no constraint)
+    double intraClusterFraction = -1;
+
+    // Portion of flows going to a cluster head with hotspot model
+    double hotspotFraction = 0.5;
+
+    // Traffic class (be, bk, vi, vo) of flows inside a cluster and between clusters
+    // Levels get QoS MACs whenever a class other than be is used (see FlowClassTag)
+    std::string intraClusterClass = "be", interClusterClass = "be";
+
+    // CSV with flows to use instead of a model (srcCluster,srcNode,dstCluster,dstNode)
+    std::string trafficFile = "";
+
+    // Captured trace (CSV or pcap) to replay instead of flows (see TraceReplay)
+    std::string traceFile = "";
+
+    // Trace records kept in memory ahead of the simulation
+    int traceReadAhead = 4096;
+
     // Simulation time
     double simulationTime = 30.0; // Seconds
+
+    // Seed for random generators (0 means take it from current time)
+    uint32_t seed = 0;
+
+    // How addresses are given to clusters
+    // flat: a /24 per cluster from a different base on each level
+    // hierarchical: networks derived from cluster position (see HierarchicalAddressAllocator)
+    std::string addressPlan = "hierarchical";
+
+    // Routing used for the whole hierarchy
+    // olsr: flat OLSR over every node of every level
+    // hierarchical: static routes calculated from clusters tree (see HierarchicalRouting)
+    std::string routingMode = "olsr";
+
+    // Table used by hierarchical routing
+    // trie: TrieRouting (longest prefix match on a compressed trie)
+    // linear: Ipv4StaticRouting
+    std::string routeLookup = "trie";
+
+    // Maximum distance between gateways to be considered neighbours by hierarchical routing
+    // (0 means every gateway in a cluster can reach the others directly)
+    double routingRange = 0;
+
+    // PHY profile of each level (see PhyProfile), on top of the defaults:
+    // level 1 AARF, level 2 constant secondLayerResources, upper levels constant OfdmRate54Mbps
+    std::string phyProfile1 = "", phyProfile2 = "", phyProfile3 = "", phyProfile4 = "";
+
+    // Final profile of each level
+    std::vector<PhyProfile> phyProfiles() const;
+
+    // Medium of upper levels (see BackboneProfile), wifi when empty
+    std::string backbone2 = "", backbone3 = "", backbone4 = "";
+
+    // Final backbone of each level (first level is always wifi)
+    std::vector<BackboneProfile> backbones() const;
+
+    // Spectrum of first level clusters
+    // private: a channel per cluster (no interference between clusters)
+    // dsatur, greedy, roundRobin: nChannels shared channels planned by ChannelPlanner
+    std::string channelPlan = "private";
+    int nChannels = 3;
+    double interferenceRange = 200; // Meters between heads for clusters to interfere
+
+    // Targets a run is checked against (see EarlyStopMonitor)
+    double lossTarget = -1;      // Highest loss rate (negative means no target)
+    double throughputTarget = 0; // Lowest throughput, Pkt/s (0 means no target)
+
+    // Early stop, once outcome against targets is known with this confidence
+    double earlyStopConfidence = 0.99;
+    double earlyStopInterval = 1.0; // Seconds between checks
+    int earlyStopMinPackets = 200;  // Packets sent before deciding on any target
+
+    // Time series of level metrics (see TimeSeriesCollector), nothing written when empty
+    std::string timeSeriesFile = "";
+    double timeSeriesInterval = 1.0; // Seconds
+    int timeSeriesBuffer = 4096;     // Samples kept in memory before writing
+
+    // Admission control at first level heads (see HeadAdmissionQueueDisc)
+    // off: heads forward anything, police: drop packets over budget, shape: delay them
+    std::string admission = "off";
+    double admissionBurst = 1.0;    // Seconds of a member's resources its bucket holds
+    double admissionHeadroom = 1.0; // Budgets are resources times this
+
+    // Head rotation among the nodes with most resources of each first level cluster
+    // (see HeadRotation), seconds between elections (0 means heads don't change)
+    double headRotationInterval = 0;
+    int headCandidates = 3;              // Nodes able to head a cluster, counting the head
+    double headRotationHysteresis = 0.1; // Margin a candidate must beat the head by
+
+    // Multi-head clusters: nodes of each cluster attached to the level above, on first,
+    // second and third levels. Members pick the first level gateway of inter-cluster
+    // packets by gatewaySelection (hash of addresses, or leastLoad: shortest uplink queue)
+    int gateways1 = 1;
+    int gateways2 = 1;
+    int gateways3 = 1;
+    std::string gatewaySelection = "hash";
+
+    // Heads listed per level in the head load report (0 means heads aren't watched)
+    int headReport = 0;
+    double headSampleInterval = 0.1; // Seconds between queue samples
+
+    // What main should do (single, testPhyRatio, compareRouting, compareAdmission, compareRotation,
+    // compareGateways, estimateGrowth, explorePareto, benchmarkLookup, exportResults)
+    std::string mode = "single";
+
+    // ResultStore where runs are appended (nothing saved when empty)
+    std::string resultsFile = "";
+
+    // CSV written from resultsFile by exportResults mode (details export with resultsFile=<file>.details)
+    std::string csvFile = "results.csv";
+
+    // Directory of cached results, one file per configuration (no cache when empty)
+    std::string cacheDir = "";
+
+    // Every parameter affecting results, as a ResultStore row
+    ResultRow parameters() const;
+
+    // Parameters and results of a run as a ResultStore row
+    // (per node and per channel stats go to details instead, so its schema doesn't grow
+    // with the network)
+    ResultRow describe(const SimulationResult &) const;
+
+    // Per node and per channel stats of a run, a (runId, stat, value) row each
+    std::vector<ResultRow> details(const SimulationResult &) const;
+
+    // Fill parameters Run derives (sizes of top levels, seed taken from the clock), so runs
+    // are hashed, cached and saved as they actually run
+    void normalize();
+
+    // Hash of parameters, files they name and code version (empty when runs can't be repeated)
+    std::string configKey() const;
+
+    // Look for a run of this configuration in cacheDir
+    bool cachedResult(SimulationResult &) const;
+
+    // Save a run to cacheDir
+    void cacheResult(const SimulationResult &) const;
+
+    // Run, unless configuration is in cacheDir
+    SimulationResult RunCached();
+
+    // Journal making sweeps resumable (sweeps can't be resumed when empty)
+    std::string journalFile = "";
+
+    // Runs at once in sweeps running side by side (0 means one per core)
+    int jobs = 0;
+
+    // Growth factor estimation (see GrowthEstimator)
+    std::string growthLevels = "2,3";     // Level counts swept
+    std::string growthSizes = "2,4,8,16"; // First level clusters swept
+    int growthReplications = 3;           // Seeds searched per size
+    double growthMinResources = 100000;   // Grid of resources per first level cluster
+    double growthMaxResources = 10000000;
+    int growthGridSize = 16;
+    double growthConfidence = 0.95;       // Of fitted factors and mean resources
+    std::string growthFile = "";          // CSV of resources found by each search (none when empty)
+
+    // Pareto frontier exploration (see ParetoExplorer)
+    int paretoPopulation = 16;
+    int paretoGenerations = 8;
+    double paretoMinResources = 100000; // Bounds of resources per first level cluster
+    double paretoMaxResources = 5000000;
+    std::string paretoRates = "OfdmRate6Mbps,OfdmRate12Mbps,OfdmRate24Mbps,OfdmRate36Mbps,OfdmRate48Mbps,OfdmRate54Mbps";
+    double paretoMutation = 0.3;  // Deviation of log resources when mutating
+    std::string paretoFile = "";  // CSV of the frontier (none when empty)
+
+    // Append run to resultsFile, and its details to resultsFile.details, if any
+    void saveResult(const SimulationResult &) const;
+
+    // Same, through stores of a sweep (which append many runs at once)
+    void saveResult(const SimulationResult &, ResultStore &, ResultStore &) const;
+};
+
+// Single application sending any number of on/off flows from a node
+// Flows are kept in plain arrays and driven by one event heap, so each flow costs a few
+// dozen bytes and no socket, random variables or timers of its own
+class MultiFlowOnOffApplication : public Application
+{
+public:
+    static TypeId GetTypeId();
+
+    // Default constructor
+    MultiFlowOnOffApplication();
+
+    // Add a flow (remote address, port, data rate, mean on time, mean off time, FlowClassTag class),
+    // returns its index
+    uint32_t addFlow(Ipv4Address, uint16_t, DataRate, double, double, uint8_t);
+
+    // Number of flows
+    uint32_t getNFlows() const;
+
+    // Fix random streams, returns how many were used
+    int64_t AssignStreams(int64_t);
+
+protected:
+    void DoDispose() override;
+
+private:
+    void StartApplication() override;
+    void StopApplication() override;
+
+    // Process due flows and schedule the next one
+    void handleEvents();
+
+    // Schedule simulator event for the earliest flow
+    void scheduleNext();
+
+    // Flows state, one entry per flow
+    std::vector<uint32_t> remoteAddresses;
+    std::vector<uint16_t> remotePorts;
+    std::vector<int64_t> intervals; // Time steps between packets while on
+    std::vector<float> meanOnTimes, meanOffTimes;
+    std::vector<int64_t> periodEnds; // Time step when current on/off period ends
+    std::vector<uint8_t> isOn;
+    std::vector<uint8_t> flowClasses;
+
+    // Next time step each flow needs attention
+    std::priority_queue<std::pair<int64_t, uint32_t>, std::vector<std::pair<int64_t, uint32_t>>,
+                        std::greater<std::pair<int64_t, uint32_t>>>
+        pending;
+
+    // Event for the earliest flow
+    EventId nextEvent;
+
+    // Whether application is running
+    bool running;
+
+    // One socket and one packet for every flow
+    Ptr<Socket> socket;
+    Ptr<Packet> templatePacket;
+    uint32_t packetSize;
+
+    // On/Off periods
+    Ptr<ExponentialRandomVariable> random;
+
+    // Sent packets
+    TracedCallback<Ptr<const Packet>> txTrace;
 };
 
 // Save a specific node useful info (resources actually)
@@ -153,11 +642,12 @@ public:
     // Referenc parent experiment
     Taller1Experiment *parent = NULL;
 
-    // Whether this node was already configured as receiver in past or not
-    bool configuredAsReceiver = false;
+    // On/Off times, shared by every flow this node sends
+    // (created once, instead of parsing an attribute string per flow)
+    Ptr<ExponentialRandomVariable> onTime, offTime;
 
-    // Whether this node was already configured as sender in past or not
-    bool configuredAsSender = false;
+    // Application sending every flow of this node (multiflow traffic only)
+    Ptr<MultiFlowOnOffApplication> multiFlowApp;
 
     // Finally, the resources on this node are calculated with the following formula
     // resources = DataRate * trafficRatio
@@ -175,14 +665,11 @@ public:
     // Calculate resources
     double getResources();
 
-    // Generate and track traffic
-    ApplicationContainer connectWithNode(ClusterNode &, Taller1Experiment *);
+    // Generate and track traffic (flows sent with a FlowClassTag class)
+    ApplicationContainer connectWithNode(ClusterNode &, Taller1Experiment *, uint8_t);
 
     // Callbacks
 
-    // On packet receive
-    void ReceivePacket(Ptr<Socket> socket);
-
     // On packet sent
     void OnPacketSent(Ptr<const Packet> packet);
 
@@ -190,6 +677,38 @@ public:
     void configureAsReceiver(Taller1Experiment *);
 };
 
+// Receives every flow reaching a node through a single socket
+// Flows are told apart by source address and port (from RecvFrom), so receiving
+// state grows with nodes and distinct sources instead of connections
+class FlowSink
+{
+public:
+    // Counters of a single flow
+    struct FlowCounters
+    {
+        uint64_t packets = 0;
+        uint64_t bytes = 0;
+    };
+
+    // Counters, indexed by flow id (given in order of arrival)
+    std::vector<FlowCounters> flows;
+
+    // Flow ids, by source (address << 16 | port)
+    std::unordered_map<uint64_t, uint32_t> flowIds;
+
+    // Reference parent experiment
+    Taller1Experiment *parent;
+
+    // Listening socket
+    Ptr<Socket> socket;
+
+    // Bind a socket on node's first level address
+    FlowSink(Ptr<Node>, uint16_t, Taller1Experiment *);
+
+    // On packet receive
+    void receivePacket(Ptr<Socket>);
+};
+
 // Collection of nodes with a head
 class Cluster
 {
@@ -203,12 +722,31 @@ public:
     // Container for head
     NodeContainer headContainer;
 
+    // Nodes able to head the cluster, head first (just the head unless heads rotate)
+    NodeContainer headCandidates;
+
+    // Nodes attached to upper level, gateway first (just the gateway unless multi-head)
+    NodeContainer gateways;
+
     // All devices (physic interfaces within this cluster)
     NetDeviceContainer ns3Devices;
 
     // Cluster Index
     int index;
 
+    // Node representing this cluster on the upper level
+    // (head for first level, further levels take a member of its first child cluster)
+    Ptr<Node> gateway;
+
+    // Index of the parent cluster within upper level (-1 for top level)
+    int parent = -1;
+
+    // Indexes of child clusters within lower level (empty for first level)
+    std::vector<int> children;
+
+    // Networks reachable inside this cluster's subtree
+    std::vector<std::pair<Ipv4Address, Ipv4Mask>> prefixes;
+
     // Save an array of clusterNodes
 
     // Created only for first level clusters, then tested with different values by higher levels
@@ -248,806 +786,7780 @@ public:
     double getResources();
 };
 
-double TruncatedDistribution(int, double, double, int);
-
-ClusterNode::ClusterNode(
-    int _index,
-    bool includesResources,
-    double _trafficRatio,
-    double arg2,
-    Ptr<Node> _node)
-{
-    // Always must be passed as argument
-    node = _node;
-    index = _index;
-    trafficRatio = _trafficRatio;
-
-    if (includesResources)
-    {
-        // arg2 represents resources
-        dataRate = arg2 / trafficRatio;
-    }
-    else
-    {
-        // arg2 represents dataRate directly
-        dataRate = arg2;
-    }
-}
-
-double ClusterNode::getResources()
+// Static routes calculated from the Level/Cluster tree, used instead of OLSR
+// Members have a default route to their head, gateways have a route per sibling
+// subtree in the upper level and a route to their own subtree
+class HierarchicalRouting
 {
-    return trafficRatio * dataRate;
-}
+public:
+    // Metric used to recognize the routes installed by this class
+    static const uint32_t routeMetric = 7;
 
-// Configure random packet sending
-ApplicationContainer ClusterNode::connectWithNode(ClusterNode &receiver, Taller1Experiment *_parent)
-{
-    // Firstly, update parent
-    parent = _parent;
+    // All levels in the hierarchy (first level goes first)
+    std::vector<Level *> levels;
 
-    // Configure sender node
-    OnOffHelper onoff("ns3::UdpSocketFactory", Address());
+    // Gateways further than this distance aren't neighbours (0 means no limit)
+    double range = 0;
 
-    // According to:
-    // https://revistas.udistrital.edu.co/index.php/Tecnura/article/view/6754/8337
-    // The correct portion of time a node is sending data is calculated as:
-    // P = (u_on / (u_on + u_off)), where u_on and u_off represent the portion of time
-    // the node is sending data and the portion of time the node is not sending data
-    // respectively. Both are distributed exponentially
-    // Configure OnOff properties
+    // Levels on a wired backbone (csma or p2p), where every gateway reaches every other
+    // whatever the range
+    std::vector<bool> wiredLevels;
 
-    std::stringstream ssOffTime;
-    ssOffTime << "ns3::ExponentialRandomVariable[Mean="
-              << parent->meanOffTime
-              << "]";
+    // Number of routes currently installed
+    uint32_t nRoutes = 0;
 
-    // Lets set OffTIme as always 1.0 to simplify calculations
-    onoff.SetAttribute("OffTime", StringValue(ssOffTime.str()));
+    // Number of recomputations caused by gateways mobility
+    uint32_t nRecomputations = 0;
 
-    // trafficRatio should be the expected probability
-    // of a node being on
-    // So, we can calculate the mean of the exponential distribution
+    // Default constructor
+    HierarchicalRouting() {}
 
-    std::stringstream ss;
-    ss << "ns3::ExponentialRandomVariable[Mean="
-       << (trafficRatio * 0.1 / (1 - trafficRatio)) // This is A_y_i
-       << "]";
-    onoff.SetAttribute("OnTime", StringValue(ss.str()));
+    // Calculate and install routes for every node in the hierarchy
+    void build(std::vector<Level *>, double);
 
-    // Set onoff rate
-    // Both Data rate and off time are components of resources
-    // Configure data rate (bps)
-    onoff.SetAttribute("DataRate", DataRateValue(DataRate(dataRate)));
+    // Recalculate routes of gateways attached to a cluster (level index starts at 0)
+    void recomputeCluster(int, int);
 
-    // // Configure receiver node
-    Ptr<Node> receiverNs3Node = receiver.node;
+    // Called when a gateway moves, only useful when range is limited
+    void onGatewayCourseChange(int, int);
 
-    // // Configure packet size
-    uint32_t pktSize = 1024;
-    onoff.SetAttribute("PacketSize", UintegerValue(pktSize));
+private:
+    // Route to be installed on a node
+    struct Route
+    {
+        Ipv4Address network;
+        Ipv4Mask mask;
+        Ipv4Address nextHop;
+    };
 
-    // Note that head nodes have their "external" address assignated first
-    // So this packet will be sent there on that case
-    Ipv4Address remoteAddr = receiverNs3Node->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+    // Roles (level, cluster) each node has as a cluster gateway, by node id
+    std::map<uint32_t, std::vector<std::pair<int, int>>> gatewayRoles;
 
-    // Configure sender node
-    AddressValue remoteAddress(InetSocketAddress(remoteAddr, parent->port));
-    onoff.SetAttribute("Remote", remoteAddress);
+    // First level cluster each node belongs to, by node id
+    std::map<uint32_t, int> leafOf;
 
-    ApplicationContainer sendApp = onoff.Install(node);
-    sendApp.Start(Seconds(0.0));
-    sendApp.Stop(Seconds(parent->simulationTime));
+    // Last known neighbourhood among children gateways, by (level, cluster)
+    std::map<std::pair<int, int>, std::vector<bool>> neighbourhoods;
 
-    receiver.configureAsReceiver(parent);
+    // Calculate whether children gateways of a cluster are in range of each other
+    std::vector<bool> calculateNeighbourhood(int, int);
 
-    // Check if current node hasn't been configured as a sender node yet
-    if (!configuredAsSender)
-    {
-        // Configure packet sink tracker
-        std::string path = "/NodeList/" + std::to_string(node->GetId()) + "/ApplicationList/*/$ns3::OnOffApplication/Tx";
-        Config::ConnectWithoutContext(path, MakeCallback(&ClusterNode::OnPacketSent, this));
-    }
-    else
-    {
-        // Otherwise sent packets would be counted twice!
-        configuredAsSender = true;
-    }
+    // Next hop (inside a cluster) from one child gateway to another
+    Ipv4Address hopTowards(int, int, int, int);
 
-    return sendApp;
-}
+    // Calculate and install routes of a single node
+    void installNode(Ptr<Node>);
+};
 
-// Configure node as receiver
-void ClusterNode::configureAsReceiver(Taller1Experiment *_parent)
+// Flow between two first level nodes
+struct TrafficFlow
 {
-    if (configuredAsReceiver)
-        return;
+    // Sender, as cluster index and node index within cluster
+    uint32_t srcCluster, srcNode;
 
-    parent = _parent;
+    // Receiver, same as sender
+    uint32_t dstCluster, dstNode;
+};
 
-    // Configure packet sink tracker
-    TypeId tid = TypeId::LookupByName("ns3::UdpSocketFactory");
-    Ptr<Socket> recvSink = Socket::CreateSocket(node, tid);
+// Set of flows to simulate, either generated from a model or loaded from a CSV
+class TrafficMatrix
+{
+public:
+    std::vector<TrafficFlow> flows;
 
-    Ipv4Address remoteAddr = node->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+    // Default constructor
+    TrafficMatrix() {}
 
-    InetSocketAddress local = InetSocketAddress(remoteAddr, parent->port);
-    recvSink->Bind(local);
-    recvSink->SetRecvCallback(MakeCallback(&ClusterNode::ReceivePacket, this));
+    // Generate flows over first level nodes
+    // uniform: any sender, any receiver
+    // gravity: senders and receivers picked proportionally to their resources
+    // hotspot: a portion of flows go to cluster heads
+    // intraClusterFraction (if not negative) forces that portion of flows to stay in their cluster
+    void generate(std::string, int, Level &, double, double, uint32_t);
 
-    configuredAsReceiver = true;
-}
+    // Load flows from a CSV (srcCluster,srcNode,dstCluster,dstNode), # starts a comment
+    void load(std::string, Level &);
 
-// Callback for packet sent BY node
-void ClusterNode::OnPacketSent(Ptr<const Packet> packet)
-{
-    parent->sentCount++; // Propagate callback to parent
-}
+    // Group flows by sender in O(flows + nodes), keeping their relative order
+    void sortBySender(Level &);
+};
 
-// Callback for packet received BY node
-void ClusterNode::ReceivePacket(Ptr<Socket> socket)
+// Replays packets captured on a real network, from a CSV (time,size,src,dst) or a pcap
+// The trace is read in chunks of at most readAhead records and a single event is pending
+// at any time, so memory doesn't depend on trace length. Endpoints (numbers or IPv4
+// addresses) are hashed onto first level nodes
+class TraceReplay
 {
-    while (socket->GetRxAvailable() > 0)
+public:
+    // A packet from the trace
+    struct TracePacket
     {
-        // Multiple packets could have reached, they must be "read" by means of Recv()
-        socket->Recv();
-        parent->receivedCount++; // Propagate callback to parent
-    }
-}
+        int64_t time; // Nanoseconds, as in the trace
+        uint32_t size;
+        uint32_t src, dst;
+    };
 
-// Create nodes contaner with specified number of nodes
-Cluster::Cluster(int _index)
-{
-    // Save cluster index, useful for some tricks like SSID assignation
-    index = _index;
-}
+    // Packets sent, and trace records which couldn't be used
+    uint64_t nReplayed = 0, nSkipped = 0;
 
-// Generate nodes when there are not nodes available
-void Cluster::generateNodes(int nNodes)
-{
-    // Create nodes
-    ns3Nodes.Create(nNodes);
-}
+    // Open trace (format is detected from its first bytes)
+    TraceReplay(std::string, uint32_t, Level &, Taller1Experiment *);
 
-// Save data from existent nodes
-void Cluster::setNodes(NodeContainer _nodes)
-{
-    ns3Nodes = _nodes;
-}
+    // Schedule first packet
+    void start();
 
-// Create cluster nodes (here we will save some useful data, like node's resources)
-void Cluster::createClusterNodes(double trafficRatio, double totalResouces, double probability)
-{
-    int length = ns3Nodes.GetN();
+private:
+    std::ifstream file;
+    bool isPcap = false;
 
-    for (int j = 0; j < length; j++)
-    {
-        // Get resources for node
-        double nodeResources = TruncatedDistribution(
-            length, totalResouces, probability, j);
+    // Pcap details
+    bool swapped = false, nanoseconds = false;
+    uint32_t linkType = 1;
 
-        nodes.push_back(ClusterNode(j, true, trafficRatio, nodeResources, ns3Nodes.Get(j)));
-    }
-}
+    // Read-ahead buffer
+    std::deque<TracePacket> buffer;
+    uint32_t readAhead;
+    bool finished = false;
 
-// Set cluster head (comes from level container)
-void Cluster::separateHead(uint32_t headIndex)
-{
-    Ptr<Node> head = ns3Nodes.Get(headIndex);
+    // First trace timestamp, which becomes simulation time 0
+    int64_t firstTime = -1;
 
-    // Refactor containers to have consistency
-    for (uint32_t i = 0; i < ns3Nodes.GetN(); i++)
-    {
-        if (i == headIndex)
-            continue;
+    // First level nodes endpoints are mapped to
+    std::vector<ClusterNode *> endpoints;
 
-        ns3NodesExcludingHead.Add(ns3Nodes.Get(i));
-    }
+    // Sending sockets, by node id (created on first use)
+    std::unordered_map<uint32_t, Ptr<Socket>> sockets;
 
-    // Update head-only container
-    headContainer.Add(head);
-}
+    Taller1Experiment *parent;
 
-// Calculate expected resources for this cluster
-double Cluster::getResources()
-{
-    double resources = 0;
+    // Fill buffer up to readAhead records
+    void refill();
 
-    for (ClusterNode node : nodes)
-    {
-        resources += node.getResources();
-    }
+    // Read next record, false at end of trace
+    bool readCsvRecord(TracePacket &);
+    bool readPcapRecord(TracePacket &);
 
-    return resources;
-}
+    // Node an endpoint maps to
+    ClusterNode &mapEndpoint(uint32_t);
 
-// Calculate level resources
-double Level::getResources()
+    // Send packet at the front and schedule the next one
+    void sendNext();
+};
+
+// PHY and MAC settings of a level, given as comma separated "key=value" pairs:
+// standard (11a, 11g, 11n, 11n2.4, 11ac, 11ax, 11ax2.4), width (channel width in MHz),
+// manager (constant, aarf, minstrel, ideal), mode (data mode of constant manager, such as
+// OfdmRate54Mbps, HtMcs7, VhtMcs9 or HeMcs11), ampdu, amsdu (largest aggregates
+// in bytes of every access category, HT and later), qos (QoS MAC on legacy standards too) and "<ac>.<attribute>"
+// for EDCA parameters of an access category, such as vi.MinCw=7 or vo.TxopLimit=1504us
+// (ac is be, bk, vi or vo; attribute any of QosTxop). Keys not given keep their value
+struct PhyProfile
 {
-    double resources = 0;
+    std::string standard = "11a";
+    uint16_t width = 0; // 0 keeps standard default
+    std::string manager = "constant";
+    std::string mode = "OfdmRate54Mbps";
+    uint32_t ampdu = 0, amsdu = 0; // 0 keeps standard default
+    bool qos = false;
 
-    for (Cluster cluster : clusters)
-    {
-        resources += cluster.getResources();
-    }
+    // EDCA settings, "<ac>.<attribute>" -> value
+    std::map<std::string, std::string> edca;
 
-    return resources;
-}
+    // Override settings from a profile string
+    void apply(std::string);
 
-// Truncated distribution assigner
-double
-TruncatedDistribution(
-    int nPoints, double totalResources, double probability, int nodeIndex)
-{
-    // Here joins probability density function for truncated geometric distribution
-    // Portion of total resources this node will take
+    // HT and later standards (QoS MAC, aggregation)
+    bool highThroughput() const;
 
-    double portion = probability * pow(1 - probability, nodeIndex) / (1 - pow(1 - probability, nPoints));
-    // Return resources to assign to node
-    return portion * totalResources;
-}
+    // MAC has a queue per access category
+    bool qosSupported() const;
 
-// Default constructor
-Taller1Experiment::Taller1Experiment()
-    // Default port to 9
-    : port(9),
-      // Default number of levels to 2
-      nLevels(2),
-      // Default number of clusters in 1st level to 6
-      nClusters_1st_level(6),
-      // Default number of nodes per cluster in 1st level to 6
-      nNodes_pC_1st_level(6),
-      // Default number of clusters in 2nd level to 2
-      nClusters_2nd_level(1),
-      // Default number of nodes per cluster in 2nd level to 2
-      nNodes_pC_2nd_level(6),
-      // Default number of clusters in 3rd level to 1
-      nClusters_3rd_level(1),
-      // Default number of nodes per cluster in 3rd level to 2
-      nNodes_pC_3rd_level(1),
-      // Default width to 500
-      width(100),
-      // Default height to 500
-      height(100)
-{
-}
+    // Set standard and manager on helper, returns phy helper with channel width
+    YansWifiPhyHelper configure(WifiHelper &, const YansWifiPhyHelper &) const;
 
-// Receive and set command line arguments
-void Taller1Experiment::HandleCommandLineArgs(int argc, char **argv, double resources[])
-{
-    /*
-     * Get console parameters
-     */
-    CommandLine cmd(__FILE__);
+    // Set aggregation limits and EDCA parameters on installed devices
+    void configureMac(NetDeviceContainer) const;
 
-    // Solving a bug which doesn't allow you to read integers from command line
-    double nc1l = nClusters_1st_level;
-    double nn1l = nNodes_pC_1st_level;
-    double nc2l = nClusters_2nd_level;
-    double nn2l = nNodes_pC_2nd_level;
-    double nc3l = nClusters_3rd_level;
-    double nn3l = nNodes_pC_3rd_level;
-    double nlevels = nLevels;
+    // Profile as a string, for results
+    std::string describe() const;
+};
 
-    // Number of hierarchy levels
-    cmd.AddValue("nLevels", "Number of levels of this cluster", nlevels);
+// Wired medium of an upper level, given as comma separated "key=value" pairs:
+// medium (wifi, csma, p2p), rate (such as 1Gbps), delay (such as 1ms) and qdisc (root
+// queue disc: pfifo_fast, fifo, red, codel, fq_codel, none or an ns-3 type name)
+// A bare word is taken as the medium. csma puts the cluster on a single LAN, p2p links
+// every pair of members (so members stay one hop apart, as on wifi)
+struct BackboneProfile
+{
+    std::string medium = "wifi";
+    std::string rate = "1Gbps";
+    std::string delay = "1ms";
+    std::string qdisc = "pfifo_fast";
 
-    // Data for first level
-    cmd.AddValue("nClusters_1st_level", "Number of clusters in 1st level", nc1l);
-    cmd.AddValue("nNodes_pC_1st_level", "Number of nodes per cluster in 1st level", nn1l);
+    // Override settings from a profile string
+    void apply(std::string);
 
-    // Data for second level
-    cmd.AddValue("nClusters_2nd_level", "Number of clusters in 2nd level", nc2l);
-    cmd.AddValue("nNodes_pC_2nd_level", "Number of nodes per cluster in 2nd level", nn2l);
+    bool wired() const;
+    bool pointToPoint() const;
 
-    // Data for third level
-    cmd.AddValue("nClusters_3rd_level", "Number of clusters in 3rd level", nc3l);
-    cmd.AddValue("nNodes_pC_3rd_level", "Number of nodes per cluster in 3rd level", nn3l);
+    // Connect nodes, returns devices (point to point links get addresses from helper)
+    NetDeviceContainer install(NodeContainer, Ipv4AddressHelper &) const;
 
-    // Second level resources
-    cmd.AddValue("secondLayerResources", "Resources for second layer", secondLayerResources);
+    // Replace root queue disc of devices (after addresses, which install a default one)
+    void configureQueues(NetDeviceContainer) const;
 
-    // Traffic ratio and mean offtime params
-    cmd.AddValue("trafficRatio", "Traffic ratio per node", trafficRatio);
-    cmd.AddValue("meanOffTime", "Mean offtime per node", meanOffTime);
+    // Profile as a string, for results
+    std::string describe() const;
+};
 
-    // Space bounds
-    cmd.AddValue("width", "Width of the space", width);
-    cmd.AddValue("height", "Height of the space", height);
+// Token bucket, in bytes
+struct TokenBucket
+{
+    double rate = 0;  // Bytes per second
+    double depth = 0; // Bytes
+    double tokens = 0;
+    Time last;
 
-    // Simulation time
-    cmd.AddValue("simulationTime", "Simulation time in seconds", simulationTime);
+    // Starts full
+    TokenBucket() {}
+    TokenBucket(double, double);
 
-    // Parse arguments
-    cmd.Parse(argc, argv);
+    // Add tokens earned until a time
+    void refill(Time);
 
-    // Set values to class attributes
-    nLevels = (int)nlevels;
-    nClusters_1st_level = (int)nc1l;
-    nNodes_pC_1st_level = (int)nn1l;
-    nClusters_2nd_level = (int)nc2l;
-    nNodes_pC_2nd_level = (int)nn2l;
-    nClusters_3rd_level = (int)nc3l;
-    nNodes_pC_3rd_level = (int)nn3l;
+    // Time until a packet of this size conforms (zero when it already does)
+    Time wait(uint32_t) const;
+};
 
-    // Set further arguments
+// Resources a first level cluster may send through its head, shared by every device of
+// the head: a bucket per member (by address) and one for the whole cluster
+struct AdmissionBudget
+{
+    std::vector<TokenBucket> members;
+    TokenBucket aggregate;
 
-    // Set values to vector of resources on First Layer
-    // Its size should match the number of first layer cluster
+    // Index in members of each member address
+    std::unordered_map<uint32_t, uint32_t> memberIndexes;
 
-    firstLayerResources = std::vector<double>(
-        resources, resources + nClusters_1st_level);
-}
+    // Member packets let through, and dropped by each bucket
+    uint64_t admitted = 0, memberDrops = 0, aggregateDrops = 0;
 
-SimulationResult Taller1Experiment::Run()
+    // Index of the member sending an item (members.size() for any other traffic)
+    uint32_t memberOf(Ptr<const QueueDiscItem>);
+};
+
+// Root queue disc of first level heads, enforcing the resources given to members
+// Packets from members must conform to both the member's and the cluster's bucket.
+// Policing drops packets that don't conform on arrival, shaping keeps them on a queue per
+// member and serves members in turn whenever their front packet conforms (so a member
+// over budget doesn't hold the others). Any other traffic (head's own, transit, routing)
+// goes first on a queue of its own and isn't limited
+class HeadAdmissionQueueDisc : public QueueDisc
 {
-    bool verbose = true;
+public:
+    static TypeId GetTypeId();
 
-    // Randomize
-    std::srand(std::time(nullptr));
-    RngSeedManager::SetSeed(std::rand());
+    HeadAdmissionQueueDisc();
 
-    if (verbose)
-        std::cout << "Starting configuration..." << std::endl;
+    static constexpr const char *LIMIT_EXCEEDED_DROP = "Queue disc limit exceeded";
+    static constexpr const char *MEMBER_DROP = "Member over budget";
+    static constexpr const char *AGGREGATE_DROP = "Cluster over budget";
 
-    //
-    // Configure physical layer
-    //
+    std::shared_ptr<AdmissionBudget> budget;
 
-    // Wifi channel
-    YansWifiChannelHelper channel = YansWifiChannelHelper::Default();
+    // Whether packets over budget wait instead of being dropped
+    bool shape = false;
 
-    // Using friss propagation loss model
-    // It considers variables such as waves distortion due to obstacles, diffraction and related phenomena
-    channel.AddPropagationLoss(
-        "ns3::FriisPropagationLossModel");
+    // Replace root queue disc of every device of each first level head (police or shape)
+    static std::vector<std::shared_ptr<AdmissionBudget>> install(Level &, std::string, double, double);
 
-    // Use constant speed propagation delay model
-    channel.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
+protected:
+    void DoDispose() override;
 
-    // Configure transmission channel
-    YansWifiPhyHelper phy;
+private:
+    bool DoEnqueue(Ptr<QueueDiscItem>) override;
+    Ptr<QueueDiscItem> DoDequeue() override;
+    bool CheckConfig() override;
+    void InitializeParams() override;
 
-    phy.Set("TxPowerStart", DoubleValue(100.0));
-    phy.Set("TxPowerEnd", DoubleValue(100.0));
+    // Take tokens for a member packet from both buckets, if it conforms
+    bool admit(TokenBucket &, uint32_t);
 
-    // Define speed (Which is distributed uniformly between 0 and 1 (units are m/s))
-    double nodeMinSpeed = 0.0, nodeMaxSpeed = 1.0;
-    std::stringstream ssSpeed;
-    ssSpeed << "ns3::UniformRandomVariable[Min=" << nodeMinSpeed << "|Max=" << nodeMaxSpeed << "]";
+    // Member served first on next dequeue (shaping only)
+    uint32_t nextMember = 0;
 
-    // Pause refers to the time a node waits before changing direction
-    // (Node remains static while this time passes)
-    std::stringstream ssPause;
-    double nodePause = 0.0;
-    ssPause << "ns3::ConstantRandomVariable[Constant=" << nodePause << "]";
+    // Dequeue again once the first front packet conforms (shaping only)
+    EventId wakeUp;
+};
 
-    // Configure mobility model
+// Assigns channels to first level clusters from their heads positions
+// Clusters whose heads are closer than the interference range are neighbours, and
+// neighbours get different channels while there are enough. Otherwise the channel
+// shared with the fewest (and furthest) neighbours is taken
+class ChannelPlanner
+{
+public:
+    // Channel of each cluster, by method:
+    // dsatur: most constrained cluster first (saturation, then degree)
+    // greedy: clusters by degree, first free channel
+    // roundRobin: cluster index modulo channels (ignores positions)
+    static std::vector<uint32_t> plan(const std::vector<Vector> &, double, uint32_t, std::string);
+
+    // Pairs of neighbours sharing a channel
+    static uint32_t conflicts(const std::vector<Vector> &, double, const std::vector<uint32_t> &);
+};
 
-    // Firstly, get speed and pause as strings:
-    std::string sSpeed = ssSpeed.str();
-    std::string sPause = ssPause.str();
+// Gives each cluster a network derived from its position in the tree
+// First level networks come from 10.0.0.0/8, so the subtree of any head is a
+// single prefix. Upper levels networks come from a 172.16.0.0/14 block per level (up to
+// 172.24.0.0/14), the rest of 172.16.0.0/12 goes to point to point backbone links
+// (172.28.0.0/15) and gateway links of multi-head clusters (172.30.0.0/15)
+class HierarchicalAddressAllocator
+{
+public:
+    // Children per cluster on each level (first level counts nodes instead)
+    std::vector<int> fanOuts;
 
-    //
-    // Configure network stack
-    //
+    // Devices on a cluster of each level (more than fan-out with head candidates)
+    std::vector<int> devices;
 
-    // Enable OLSR
-    OlsrHelper olsr;
+    // Address bits taken by each level
+    std::vector<int> bits;
 
-    // Install network stack
-    InternetStackHelper internet;
-    internet.SetRoutingHelper(olsr); // has effect on the next Install ()
+    // Default constructor
+    HierarchicalAddressAllocator() {}
 
-    // Assign IPv4 addresses (First layer)
-    Ipv4AddressHelper ipAddrs1stLayer;
-    ipAddrs1stLayer.SetBase("10.0.0.0", "255.255.255.0");
+    // Calculate bits needed by each level (from fan-outs and devices)
+    void configure(std::vector<int>, std::vector<int>);
 
-    // Assign IPv4 addresses (Second layer)
-    Ipv4AddressHelper ipAddrs2ndLayer;
-    ipAddrs2ndLayer.SetBase("192.168.0.0", "255.255.255.0");
+    // Prefix covering the whole subtree of a cluster (level index starts at 0)
+    std::pair<Ipv4Address, Ipv4Mask> subtreePrefix(int, int);
 
-    // Assign IPv4 addresses (Third layer)
-    Ipv4AddressHelper ipAddrs3rdLayer;
-    ipAddrs3rdLayer.SetBase("172.16.0.0", "255.255.255.0");
+    // Network for the devices of a cluster
+    std::pair<Ipv4Address, Ipv4Mask> clusterNetwork(int, int);
 
-    // Assign IPv4 addresses (Fourth layer)
-    Ipv4AddressHelper ipAddrs4thLayer;
-    ipAddrs3rdLayer.SetBase("172.17.0.0", "255.255.255.0");
+    // Set helper base to the network of a cluster
+    void setBase(Ipv4AddressHelper &, int, int);
+};
 
-    // Mobility helper
-    MobilityHelper mobilityAdhoc;
+// Path compressed binary trie for longest prefix match on IPv4 addresses
+// Each node keeps the bits it covers, so lookups visit at most one node per
+// distinct prefix length along the path instead of one per bit
+class PrefixTrie
+{
+public:
+    // Default constructor, creates root (matches every address)
+    PrefixTrie();
 
-    // We are now able to create nodes
+    // Insert a prefix (replacing its value if already there)
+    void insert(uint32_t, uint8_t, uint32_t);
 
-    // Initialize all levels
-    Level first_level, second_level, third_level, fourth_level;
+    // Remove a prefix, returns whether it was there
+    bool remove(uint32_t, uint8_t);
 
-    if (verbose)
-        std::cout << "Creating first level clusters..." << std::endl;
+    // Find value of the longest prefix containing address
+    bool lookup(uint32_t, uint32_t &) const;
 
-    // Always create nodes for the first level (note actually all nodes instances will be created here)
-    // Create nodes for each cluster in first level
-    for (int i = 0; i < nClusters_1st_level; i++)
-    {
-        if (verbose)
-            std::cout << "[Lvl 1] Creating cluster #" << i << std::endl;
-        //  Create cluster
-        Cluster cluster(i);
+    // Find value of exactly this prefix
+    bool find(uint32_t, uint8_t, uint32_t &) const;
 
-        // Since we are in the first layer, create nodes
-        cluster.generateNodes(nNodes_pC_1st_level);
+    // Remove every prefix
+    void clear();
 
-        // Group nodes by defining head
-        cluster.separateHead(0); // Note node #0 is the one with highest resources
+    // Number of prefixes stored
+    uint32_t size() const;
 
-        // Physical layer
-        WifiHelper nodesWifi;
-        nodesWifi.SetRemoteStationManager("ns3::AarfWifiManager");
+private:
+    struct TrieNode
+    {
+        // Prefix bits (already masked) and how many of them are significant
+        uint32_t prefix;
+        uint8_t length;
 
-        // phy.Set("ChannelNumber", UintegerValue(1));
-        phy.SetChannel(channel.Create());
+        // Whether a prefix ends here
+        bool hasValue;
+        uint32_t value;
 
-        // Data link layer
-        WifiMacHelper nodesMac;
+        // Children indexes by next bit (-1 if none)
+        int32_t child[2];
+    };
 
-        // Each subnetwork (cluster) will be identified by a different SSID
-        std::string ssidString("wifi-cluster-");
-        std::stringstream ss;
-        ss << i; // Each SSID has the format: wifi-cluster-i
-        ssidString += ss.str();
+    // Nodes are kept in a vector, so the structure stays compact
+    std::vector<TrieNode> nodes;
 
-        Ssid ssid = Ssid(ssidString);
+    // Indexes of removed nodes, reused on next insertions
+    std::vector<int32_t> freeNodes;
 
-        nodesMac.SetType("ns3::StaWifiMac",
-                         "Ssid", SsidValue(ssid));
+    // Number of prefixes stored
+    uint32_t nPrefixes;
 
-        // Nodes will connect to their cluster head (which is actually an AP on this case)
-        NetDeviceContainer ns3DevicesExcludingHead = nodesWifi.Install(
-            phy, nodesMac, cluster.ns3NodesExcludingHead);
+    // Mask with first length bits set
+    static uint32_t maskOf(uint8_t);
 
-        // Setup heads as APs
-        nodesMac.SetType("ns3::ApWifiMac",
-                         "Ssid", SsidValue(ssid));
+    // Bit of x at position (0 is most significant)
+    static int bitAt(uint32_t, uint8_t);
 
-        NetDeviceContainer headDevice = nodesWifi.Install(phy, nodesMac, cluster.headContainer);
+    // Create a node and return its index
+    int32_t newNode(uint32_t, uint8_t);
+};
 
-        // Total cluster devices
-        cluster.ns3Devices.Add(headDevice);
-        cluster.ns3Devices.Add(ns3DevicesExcludingHead);
+// Unicast routing backed by a PrefixTrie, meant for heads with many routes
+// (Ipv4StaticRouting scans its whole list on every lookup)
+// It's added to an Ipv4ListRoutingHelper like any other protocol
+class TrieRouting : public Ipv4RoutingProtocol
+{
+public:
+    static TypeId GetTypeId();
 
-        // All nodes are including in OLSR protocol
-        internet.Install(cluster.ns3Nodes);
+    // Default constructor
+    TrieRouting() {}
 
-        // It is kinda useful to save interfaces for future connections
-        Ipv4InterfaceContainer assignedAddresses = ipAddrs1stLayer.Assign(
-            cluster.ns3Devices);
+    // Add a route to a network (replaces any route to the same network)
+    void AddNetworkRouteTo(Ipv4Address, Ipv4Mask, Ipv4Address, uint32_t, uint32_t = 0);
 
-        // Step next subnet
-        ipAddrs1stLayer.NewNetwork();
+    // Add a route to 0.0.0.0/0
+    void SetDefaultRoute(Ipv4Address, uint32_t, uint32_t = 0);
 
-        // Create nodes
-        cluster.createClusterNodes(
-            trafficRatio,
-            firstLayerResources[i],
-            probability);
-        if (verbose)
-            std::cout << "Resources in this cluster: " << cluster.getResources() << std::endl;
+    // Remove route to a network, returns whether it existed
+    bool RemoveNetworkRoute(Ipv4Address, Ipv4Mask);
 
-        // Add this cluster to first level clusters
-        first_level.clusters.push_back(cluster);
+    // Remove routes added with a given metric, returns how many were removed
+    uint32_t RemoveRoutesWithMetric(uint32_t);
 
-        // Mobility will be set later after configuring heads mobility
-    }
-    if (verbose)
-        std::cout << "[Lvl 1] Finished clusters creation..." << std::endl;
+    // Number of routes in the table
+    uint32_t GetNRoutes() const;
 
-    if (nLevels == 2)
-    {
-        // In a two layer architecture, there is actually one single cluster in second level
-        // And its nodes are sublayer's clusters heads
-        nClusters_2nd_level = 1;
-        nNodes_pC_2nd_level = nClusters_1st_level;
-    }
+    // Ipv4RoutingProtocol
+    Ptr<Ipv4Route> RouteOutput(Ptr<Packet>, const Ipv4Header &, Ptr<NetDevice>, Socket::SocketErrno &) override;
+    bool RouteInput(Ptr<const Packet>, const Ipv4Header &, Ptr<const NetDevice>,
+                    UnicastForwardCallback, MulticastForwardCallback, LocalDeliverCallback, ErrorCallback) override;
+    void NotifyInterfaceUp(uint32_t) override;
+    void NotifyInterfaceDown(uint32_t) override;
+    void NotifyAddAddress(uint32_t, Ipv4InterfaceAddress) override;
+    void NotifyRemoveAddress(uint32_t, Ipv4InterfaceAddress) override;
+    void SetIpv4(Ptr<Ipv4>) override;
+    void PrintRoutingTable(Ptr<OutputStreamWrapper>, Time::Unit = Time::S) const override;
 
-    if (verbose)
-        std::cout << "Creating second level clusters..." << std::endl;
+protected:
+    void DoDispose() override;
 
-    // Get nodes for second cluster (Heads on first level)
-    for (int i = 0; i < nClusters_2nd_level; i++)
+private:
+    struct TrieRoute
     {
-        // std::cout << "[Lvl 2] Creating cluster #" << i << std::endl;
-        //  Create cluster
-        Cluster cluster(i + nClusters_1st_level);
+        Ipv4Address network;
+        Ipv4Mask mask;
+        Ipv4Address gateway;
+        uint32_t interface;
+        uint32_t metric;
+        bool active;
+    };
 
-        NodeContainer nodes;
+    Ptr<Ipv4> ipv4;
 
-        // Get nodes for this cluster, they were created in previous step
-        for (int j = 0; j < nNodes_pC_2nd_level; j++)
-        {
-            // Add head as an element from cluster
-            nodes.Add(first_level.clusters[i * nNodes_pC_2nd_level + j].headContainer.Get(0));
-        }
+    // Trie values are indexes in routes
+    PrefixTrie trie;
+    std::vector<TrieRoute> routes;
 
-        // Set nodes in cluster
-        cluster.setNodes(nodes);
+    // Indexes of removed routes, reused on next insertions
+    std::vector<uint32_t> freeRoutes;
 
-        // Physical layer
-        WifiHelper nodesWifi;
-        nodesWifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
-                                          "DataMode", StringValue(secondLayerResources));
+    // Route (if any) for a destination
+    Ptr<Ipv4Route> lookup(Ipv4Address, Ptr<NetDevice>);
+};
 
-        phy.SetChannel(channel.Create());
+// Creates TrieRouting for InternetStackHelper / Ipv4ListRoutingHelper
+class TrieRoutingHelper : public Ipv4RoutingHelper
+{
+public:
+    TrieRoutingHelper() {}
 
-        //
-        // Configure data link layer
-        //
-        WifiMacHelper nodesMac;
-        nodesMac.SetType("ns3::AdhocWifiMac");
+    TrieRoutingHelper *Copy() const override;
+    Ptr<Ipv4RoutingProtocol> Create(Ptr<Node>) const override;
 
-        // Create physical interfaces between 2nd layer nodes
-        cluster.ns3Devices = nodesWifi.Install(
-            phy, nodesMac, cluster.ns3Nodes);
+    // Find TrieRouting on a node (directly or inside a list), null if there isn't any
+    static Ptr<TrieRouting> GetTrieRouting(Ptr<Ipv4>);
+};
 
-        // Note internet stack is already installed on nodes
-        Ipv4InterfaceContainer assignedAddresses = ipAddrs2ndLayer.Assign(
-            cluster.ns3Devices);
+// Find a routing protocol of type T on a node (directly or inside a list), null if there isn't any
+template <class T>
+Ptr<T> FindRoutingProtocol(Ptr<Ipv4> ipv4)
+{
+    Ptr<Ipv4RoutingProtocol> protocol = ipv4->GetRoutingProtocol();
 
-        // Create position allocator, random at start
+    Ptr<T> found = DynamicCast<T>(protocol);
+    if (found)
+        return found;
+
+    Ptr<Ipv4ListRouting> list = DynamicCast<Ipv4ListRouting>(protocol);
+    if (!list)
+        return NULL;
+
+    for (uint32_t i = 0; i < list->GetNRoutingProtocols(); i++)
+    {
+        int16_t priority;
+        found = DynamicCast<T>(list->GetRoutingProtocol(i, priority));
+
+        if (found)
+            return found;
+    }
+
+    return NULL;
+}
+
+// Gateways of a first level cluster, shared by the selectors of its members
+struct GatewayGroup
+{
+    // Ad hoc address and upper level device of each gateway (head first)
+    std::vector<Ipv4Address> addresses;
+    std::vector<Ptr<NetDevice>> uplinks;
+
+    // Destinations assigned and packets sent through each gateway
+    std::vector<uint32_t> destinations;
+    std::vector<uint64_t> packets;
+
+    // Gateway with the fewest frames waiting on its uplink (then fewest destinations)
+    uint32_t leastLoaded() const;
+};
+
+// Picks the gateway a member sends inter-cluster packets through, when its cluster has
+// several. hash: by source and destination addresses, leastLoad: least loaded gateway
+// when a destination is first seen (then kept, so flows aren't reordered). Packets go
+// straight to the gateway through the ad hoc device of the cluster (second interface),
+// not relayed by the head AP. Packets inside the cluster, and everything members
+// forward, are left to other protocols
+class GatewaySelectionRouting : public Ipv4RoutingProtocol
+{
+public:
+    static TypeId GetTypeId();
+
+    GatewaySelectionRouting() {}
+
+    std::shared_ptr<GatewayGroup> group;
+    std::string policy = "hash";
+
+    // Ipv4RoutingProtocol
+    Ptr<Ipv4Route> RouteOutput(Ptr<Packet>, const Ipv4Header &, Ptr<NetDevice>, Socket::SocketErrno &) override;
+    bool RouteInput(Ptr<const Packet>, const Ipv4Header &, Ptr<const NetDevice>,
+                    UnicastForwardCallback, MulticastForwardCallback, LocalDeliverCallback, ErrorCallback) override;
+    void NotifyInterfaceUp(uint32_t) override {}
+    void NotifyInterfaceDown(uint32_t) override {}
+    void NotifyAddAddress(uint32_t, Ipv4InterfaceAddress) override {}
+    void NotifyRemoveAddress(uint32_t, Ipv4InterfaceAddress) override {}
+    void SetIpv4(Ptr<Ipv4>) override;
+    void PrintRoutingTable(Ptr<OutputStreamWrapper>, Time::Unit = Time::S) const override;
+
+protected:
+    void DoDispose() override;
+
+private:
+    Ptr<Ipv4> ipv4;
+
+    // Gateway of each destination (leastLoad)
+    std::unordered_map<uint32_t, uint32_t> assigned;
+};
+
+// Counts OLSR control traffic of every node through Ipv4L3Protocol Tx/Rx traces (OLSR
+// packets are told by their UDP port). Each packet counts on the level of the interface
+// it went through, so heads split their traffic among the levels they belong to
+class OlsrOverheadTracker
+{
+public:
+    // Message kinds, in olsr::MessageHeader::MessageType order
+    static const int nKinds = 4;
+
+    // UDP port of OLSR packets
+    static const uint16_t port = 698;
+
+    // Counters for a node or a level
+    struct Counters
+    {
+        // Messages and their bytes, by kind
+        uint64_t txMessages[nKinds] = {};
+        uint64_t txBytes[nKinds] = {};
+        uint64_t rxMessages[nKinds] = {};
+        uint64_t rxBytes[nKinds] = {};
+
+        // Whole OLSR packets (header included)
+        uint64_t txPackets = 0, txPacketBytes = 0;
+        uint64_t rxPackets = 0, rxPacketBytes = 0;
+    };
+
+    // Counters by node id (every interface), and by level (first level is 0)
+    std::map<uint32_t, Counters> nodes;
+    std::vector<Counters> levels;
+
+    // Level of each interface, by node id and interface index
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> interfaceLevels;
+
+    // Default constructor
+    OlsrOverheadTracker() {}
+
+    // Connect to IPv4 of every node running OLSR
+    void install(std::vector<Level *>);
+
+    // Save per level and per node counters on results
+    void exportTo(SimulationResult &, double);
+
+    // Trace sink, counts packet if it's OLSR
+    void onPacket(bool, Ptr<const Packet>, Ptr<Ipv4>, uint32_t);
+};
+
+// Counts packets dropped in every layer, by cause, per node and per level
+// Device drops go to the level of the device, IPv4 drops to the level of the interface
+// the packet came through (level 0 for packets the node couldn't even send)
+class DropTracker
+{
+public:
+    enum Cause
+    {
+        PHY_RX,        // WifiPhy PhyRxDrop of frames to the device or a group (errors, collisions, busy receiver)
+        PHY_OVERHEARD, // WifiPhy PhyRxDrop of frames to other stations (grows with density)
+        PHY_TX,        // WifiPhy PhyTxDrop
+        MAC_TX,        // WifiMac MacTxDrop (not queued)
+        MAC_RETRY,     // Retries exhausted (MacTxFinalDataFailed)
+        WIFI_QUEUE,    // WifiMacQueue Drop and Expired
+        QUEUE_DISC,    // Root queue disc Drop (queue overflow above the device)
+        NO_ROUTE,      // Ipv4L3Protocol Drop without route
+        TTL_EXPIRED,   // Ipv4L3Protocol Drop by TTL (routing loops)
+        IP_OTHER,      // Other Ipv4L3Protocol drops
+        N_CAUSES
+    };
+
+    // Names used for statistics
+    static const char *causeNames[N_CAUSES];
+
+    // Drops by cause
+    struct Counters
+    {
+        uint64_t drops[N_CAUSES] = {};
+
+        uint64_t total() const;
+    };
+
+    // What a trace sink is bound to
+    struct Source
+    {
+        DropTracker *tracker;
+        uint32_t nodeId;
+        uint32_t level;
+        Mac48Address address; // Of wifi devices, for PhyRxDrop
+    };
+
+    // Counters by node id, and by level (0 is local)
+    std::map<uint32_t, Counters> nodes;
+    std::vector<Counters> levels;
+
+    // Level of each device, for IPv4 drops
+    std::map<Ptr<NetDevice>, uint32_t> deviceLevels;
+
+    // Connect to devices, queues and IPv4 of every level
+    void install(std::vector<Level *>);
+
+    // Count a drop
+    void count(uint32_t, uint32_t, Cause);
+
+    // Save counters on results
+    void exportTo(SimulationResult &);
+
+private:
+    // Bound to trace sinks, addresses must not change
+    std::deque<Source> sources;
+
+    Source *addSource(uint32_t, uint32_t);
+};
+
+// Watches cluster heads on every level: MAC queue length (sampled), time frames wait
+// on it and packets forwarded through it. Heads are the head of each first level
+// cluster (AP device) and members of upper level clusters (ad hoc devices)
+class HeadMonitor
+{
+public:
+    // A head on one level
+    struct HeadStats
+    {
+        uint32_t nodeId;
+        uint32_t level;
+        std::vector<Ptr<WifiMacQueue>> queues; // Every access category
+
+        uint64_t forwarded = 0;
+        Log2Histogram queueLength; // Packets
+        Log2Histogram sojourn;     // Microseconds
+    };
+
+    // Every head on every level (addresses are bound to trace sinks)
+    std::deque<HeadStats> heads;
+
+    // Heads by node id and interface index, for forwarded packets
+    std::map<uint32_t, std::map<uint32_t, HeadStats *>> interfaces;
+
+    // Connect to heads of every level and sample queues each interval
+    void install(std::vector<Level *>, double, double);
+
+    // Save heads stats and print the most loaded heads of each level
+    void report(SimulationResult &, uint32_t);
+
+private:
+    double interval, stopTime;
+
+    // Sample queue lengths and schedule next sample
+    void sample();
+};
+
+// Re-elects the head of each first level cluster every interval among its candidates
+// Candidates are scored by resources over their load: forwarded traffic (smoothed over
+// intervals, so past heads rest) relative to resources, plus MAC queue fill of the
+// current head. A candidate takes over when it beats the head by the hysteresis margin.
+// Handover puts the old head's AP and upper device to sleep and wakes the new head's
+// (stations associate again once beacons are missed), makes members move around the
+// new head and leaves routes to OLSR
+class HeadRotation
+{
+public:
+    // A node able to head its cluster
+    struct Candidate
+    {
+        Ptr<Node> node;
+        Ptr<WifiNetDevice> ap, station, uplink;
+        double resources;
+
+        double load = 0;             // Forwarded bit/s, smoothed
+        uint64_t forwardedBytes = 0; // Since last election
+    };
+
+    // Candidates of a first level cluster
+    struct ClusterState
+    {
+        uint32_t index;
+        std::vector<Candidate> candidates;
+        uint32_t head = 0;
+
+        // Mobility of the first head, which every member follows (directly or not)
+        Ptr<MobilityModel> anchor;
+
+        NodeContainer nodes;
+    };
+
+    // Every rotating cluster (candidates are bound to trace sinks)
+    std::deque<ClusterState> clusters;
+
+    uint32_t nHandovers = 0;
+
+    // Find candidates devices, put standby ones to sleep and start electing
+    void install(Level &, Level &, double, double, double);
+
+    // Save handovers and time each candidate was head
+    void report(SimulationResult &);
+
+private:
+    double interval, hysteresis, stopTime;
+
+    // Time each node spent as head, by node id
+    std::map<uint32_t, Time> headTime;
+    std::map<uint32_t, Time> headSince;
+
+    // Score candidates and hand over where a better one is found
+    void elect();
+
+    // Move head role of a cluster to a candidate
+    void handOver(ClusterState &, uint32_t);
+};
+
+// Airtime of every wifi channel, from the State trace of the phys attached to it
+// Channels are told apart by their object, so clusters sharing a channel add up. Busy
+// fraction is the mean over phys of time spent in TX, RX or CCA_BUSY. Collisions are
+// estimated from transmissions overlapping in time on the same channel
+class ChannelMonitor
+{
+public:
+    // Airtime of a channel
+    struct ChannelStats
+    {
+        uint32_t index;
+        uint32_t level;
+        uint32_t nPhys = 0;
+
+        // Added over phys
+        Time txTime, rxTime, ccaBusyTime;
+
+        // Time some phy was transmitting, and time transmissions overlapped
+        Time airtime, overlap;
+        uint64_t transmissions = 0, collisions = 0;
+
+        // Recent airtime, as sorted disjoint intervals
+        std::deque<std::pair<Time, Time>> segments;
+
+        // Account a state period of one phy
+        void onState(Time, Time, WifiPhyState);
+    };
+
+    // Stats by channel (addresses are bound to trace sinks)
+    std::map<Ptr<Channel>, ChannelStats> channels;
+
+    // Connect to phys of every level
+    void install(std::vector<Level *>);
+
+    // Save per channel and per level stats on results
+    void exportTo(SimulationResult &, double);
+};
+
+// Stops a run once its outcome against lossTarget and throughputTarget is known
+// Loss is bounded with a Wilson score interval over packets sent SETTLE_CHECKS intervals
+// ago or earlier, and those of them received (so packets still queued or in flight under
+// load aren't taken as lost). Throughput is surely missed when delivering every packet
+// sent, and sending at the highest likely rate until the end, still falls short. Nothing
+// is decided before earlyStopMinPackets were sent (and settled, for loss). Run stops when
+// a target is surely missed or every target is surely met
+class EarlyStopMonitor
+{
+public:
+    // 1 when targets were met, 0 when missed, -1 while undecided
+    int outcome = -1;
+
+    // Simulation time when run was stopped
+    double stopTime = 0;
+
+    // Start checking (nothing is done without targets)
+    void start(Taller1Experiment *);
+
+private:
+    Taller1Experiment *parent;
+
+    // Normal quantile for confidence
+    double z = 0;
+
+    // Intervals a packet gets to arrive before it's taken as lost
+    static const int SETTLE_CHECKS = 2;
+
+    // Packets sent by each check
+    std::vector<double> sentByCheck;
+
+    // Evaluate targets and stop or schedule next check
+    void check();
+};
+
+// Samples metrics of every level at a fixed interval into a ring buffer, which a
+// background thread writes to a CSV in large blocks. The simulation only copies a few
+// counters per sample, and waits only if the writer falls a whole buffer behind
+// Level 0 is end to end data traffic, other levels count MAC traffic of their devices
+class TimeSeriesCollector
+{
+public:
+    // A row of the series
+    struct Sample
+    {
+        double time;
+        uint32_t level;
+        double throughput;   // Packets received per second
+        double lossRate;     // Packets dropped over packets sent
+        double queueDepth;   // Mean packets waiting per device
+        double busyFraction; // Mean time devices found the channel busy
+    };
+
+    // Counters of a level, updated by trace sinks
+    struct LevelCounters
+    {
+        std::vector<Ptr<WifiNetDevice>> devices;
+        uint64_t txPackets = 0, rxPackets = 0, drops = 0;
+        Time busy;
+
+        // Values at previous sample
+        uint64_t lastTx = 0, lastRx = 0, lastDrops = 0;
+        Time lastBusy;
+    };
+
+    // Open CSV and start writer thread
+    TimeSeriesCollector(std::string, double, size_t);
+
+    // Write what is left
+    ~TimeSeriesCollector();
+
+    // Connect to devices of every level and schedule first sample
+    void install(std::vector<Level *>, Taller1Experiment *);
+
+    // Wait until every sample is written
+    void finish();
+
+private:
+    double interval;
+    Taller1Experiment *parent;
+
+    // Level 0 is end to end traffic
+    std::vector<LevelCounters> levels;
+    int lastSent = 0, lastReceived = 0;
+
+    // Ring buffer, positions only grow
+    std::vector<Sample> ring;
+    uint64_t written = 0, flushed = 0;
+    bool done = false;
+    std::mutex mutex;
+    std::condition_variable hasSamples, hasSpace;
+
+    FILE *file;
+    std::thread writer;
+
+    // Take a sample of every level and schedule next one
+    void sample();
+
+    // Add sample to ring buffer
+    void push(const Sample &);
+
+    // Writer thread
+    void writeSamples();
+};
+
+// Estimates how total first level resources must grow with network size to keep runs
+// within lossTarget and throughputTarget (loss under 10% when none is given)
+// Every replication of each size searches a geometric grid of resources per cluster for
+// the least sustaining the targets, by bisection (more resources are taken to never hurt).
+// Then log(resources) = log(scale) + factor * log(nodes) is fitted by least squares over
+// every search of a level count. Searches run side by side in child processes, through
+// cacheDir (so sweeps sharing points, or resumed, don't run them again)
+class GrowthEstimator
+{
+public:
+    // Resources search of a replication of a size
+    struct Search
+    {
+        int nLevels;
+        int nClusters; // First level clusters
+        int replication;
+
+        // Grid levels still possible, least sustaining is low once low == high
+        // (growthGridSize when no level sustained targets)
+        int low = 0, high = 0;
+
+        int nRuns = 0;
+        bool running = false;
+    };
+
+    // Resources against size of a level count
+    struct Fit
+    {
+        int nLevels;
+        int nPoints = 0;
+        double factor = NAN, factorHalfWidth = NAN;
+        double scale = NAN, scaleLow = NAN, scaleHigh = NAN;
+        double r2 = NAN;
+    };
+
+    // Plan searches from options
+    GrowthEstimator(int, char **);
+
+    // Run every search to the end
+    void run();
+
+    // Fit and print results (and write growthFile)
+    void report();
+
+private:
+    int argc;
+    char **argv;
+
+    // Options of the sweep
+    Taller1Experiment options;
+
+    // Resources per first level cluster of each grid level
+    std::vector<double> grid;
+
+    std::vector<Search> searches;
+
+    // Experiment of a search at a grid level
+    Taller1Experiment experiment(const Search &, int) const;
+
+    // Whether a run met the targets
+    bool sustained(const SimulationResult &) const;
+
+    // Fit resources found for a level count
+    Fit fit(int) const;
+};
+
+// Searches configurations (resources of each first level cluster and second level rate)
+// trading off total first level resources, second level rate, throughput and loss, with
+// NSGA-II. Offspring of each generation come from binary tournaments (on front, then
+// crowding distance), blend crossover and log-normal mutation of resources, and a step
+// up or down of the rate. They run side by side (see RunInChildProcesses) over the same
+// seed, then parents and offspring are sorted in non-dominated fronts and the best fill
+// the next generation. Configurations not dominated by any run so far make the frontier
+class ParetoExplorer
+{
+public:
+    // A configuration and its objectives, all minimized (first level resources,
+    // second level Mbps, throughput negated, loss rate)
+    struct Individual
+    {
+        std::vector<double> resources; // Per first level cluster
+        int rate = 0;                  // Index in paretoRates
+        std::vector<double> objectives;
+
+        // Non-dominated front (0 is best) and crowding distance within it
+        int front = 0;
+        double crowding = 0;
+    };
+
+    // Random first generation from options
+    ParetoExplorer(int, char **);
+
+    // Breed every generation
+    void run();
+
+    // Print frontier (and write paretoFile)
+    void report();
+
+private:
+    int argc;
+    char **argv;
+
+    // Options of the exploration
+    Taller1Experiment options;
+
+    // Second level modes and their Mbps
+    std::vector<std::string> rates;
+    std::vector<double> rateCosts;
+
+    std::mt19937 rng;
+
+    std::vector<Individual> population;
+
+    // Non-dominated configurations of every run
+    std::vector<Individual> frontier;
+
+    // Run configurations and take their objectives (failed runs get infinite ones)
+    void evaluate(std::vector<Individual> &);
+
+    // Child of two tournament winners
+    Individual offspring();
+
+    // Better of two random members of population
+    const Individual &tournament();
+
+    // Whether first is no worse in any objective and better in one
+    static bool dominates(const Individual &, const Individual &);
+
+    // Set front and crowding distance of every individual
+    static void sortFronts(std::vector<Individual> &);
+
+    // Add non-dominated individuals to frontier, dropping those they dominate
+    void updateFrontier(const std::vector<Individual> &);
+};
+
+double TruncatedDistribution(int, double, double, int);
+
+// Address of target on the network it shares with neighbour
+Ipv4Address AddressOnSharedNetwork(Ptr<Node>, Ptr<Node>);
+
+// Peak resident memory of current process (KiB)
+long GetPeakMemoryKb();
+
+// Start peak memory over from current resident memory
+void ResetPeakMemory();
+
+// Queues where a wifi device keeps data frames (one per access category on QoS MACs)
+std::vector<Ptr<WifiMacQueue>> DeviceQueues(Ptr<WifiNetDevice>);
+
+// Save and restore results, useful for passing them between processes
+std::string SerializeResult(const SimulationResult &);
+SimulationResult ParseResult(const std::string &);
+
+// Run an experiment in a child process (so memory usage of runs doesn't mix)
+SimulationResult RunInChildProcess(Taller1Experiment &);
+
+// Run in a child process, started by StartChildRun so several can go at once
+struct ChildRun
+{
+    pid_t pid = -1; // -1 when result was cached
+    int fd = -1;    // Read end of the pipe results come through
+    std::string data;
+    SimulationResult result;
+};
+
+// Start a run (result is ready when cached)
+ChildRun StartChildRun(Taller1Experiment &);
+
+// Read what the child wrote so far, true once it's done writing (blocks until it writes)
+bool ReadChildRun(ChildRun &);
+
+// Wait for the child and take its result
+SimulationResult FinishChildRun(Taller1Experiment &, ChildRun &);
+
+// Run experiments in child processes, up to a number at once (0 means one per core)
+// Results are in experiments order, new runs are appended to resultsFile
+std::vector<SimulationResult> RunInChildProcesses(std::vector<Taller1Experiment> &, int);
+
+// Normal quantile, by bisection on its CDF
+double NormalQuantile(double);
+
+// Student's t quantile
+double StudentQuantile(double, int);
+
+// Integers of a comma separated list
+std::vector<int> ParseIntList(std::string);
+
+// Seed of a sweep through cacheDir (given one, else the one kept there)
+uint32_t SweepSeed(uint32_t, std::string);
+
+// Whether a stat is per node or per channel (kept in result details, see ResultStore)
+bool IsDetailStat(const std::string &);
+
+ClusterNode::ClusterNode(
+    int _index,
+    bool includesResources,
+    double _trafficRatio,
+    double arg2,
+    Ptr<Node> _node)
+{
+    // Always must be passed as argument
+    node = _node;
+    index = _index;
+    trafficRatio = _trafficRatio;
+
+    if (includesResources)
+    {
+        // arg2 represents resources
+        dataRate = arg2 / trafficRatio;
+    }
+    else
+    {
+        // arg2 represents dataRate directly
+        dataRate = arg2;
+    }
+}
+
+double ClusterNode::getResources()
+{
+    return trafficRatio * dataRate;
+}
+
+// Configure random packet sending
+ApplicationContainer ClusterNode::connectWithNode(ClusterNode &receiver, Taller1Experiment *_parent, uint8_t flowClass)
+{
+    // Firstly, update parent
+    parent = _parent;
+
+    // According to:
+    // https://revistas.udistrital.edu.co/index.php/Tecnura/article/view/6754/8337
+    // The correct portion of time a node is sending data is calculated as:
+    // P = (u_on / (u_on + u_off)), where u_on and u_off represent the portion of time
+    // the node is sending data and the portion of time the node is not sending data
+    // respectively. Both are distributed exponentially
+    double meanOnTime = trafficRatio * 0.1 / (1 - trafficRatio); // This is A_y_i
+
+    // Note that head nodes have their "external" address assignated first
+    // So this packet will be sent there on that case
+    Ipv4Address remoteAddr = receiver.node->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+
+    // Every flow of this node goes through the same application
+    if (parent->trafficApplication == "multiflow")
+    {
+        if (!multiFlowApp)
+        {
+            multiFlowApp = CreateObject<MultiFlowOnOffApplication>();
+            node->AddApplication(multiFlowApp);
+            multiFlowApp->SetStartTime(Seconds(0.0));
+            multiFlowApp->SetStopTime(Seconds(parent->simulationTime));
+            multiFlowApp->TraceConnectWithoutContext("Tx", MakeCallback(&ClusterNode::OnPacketSent, this));
+        }
+
+        multiFlowApp->addFlow(remoteAddr, parent->port, DataRate(dataRate), meanOnTime, parent->meanOffTime, flowClass);
+        receiver.configureAsReceiver(parent);
+
+        return ApplicationContainer(multiFlowApp);
+    }
+
+    if (!onTime)
+    {
+        // Lets set OffTIme as always 1.0 to simplify calculations
+        offTime = CreateObject<ExponentialRandomVariable>();
+        offTime->SetAttribute("Mean", DoubleValue(parent->meanOffTime));
+
+        // trafficRatio should be the expected probability
+        // of a node being on
+        // So, we can calculate the mean of the exponential distribution
+        onTime = CreateObject<ExponentialRandomVariable>();
+        onTime->SetAttribute("Mean", DoubleValue(meanOnTime));
+    }
+
+    // Configure sender node
+    Ptr<OnOffApplication> onoff = CreateObject<OnOffApplication>();
+    onoff->SetAttribute("OnTime", PointerValue(onTime));
+    onoff->SetAttribute("OffTime", PointerValue(offTime));
+
+    // Set onoff rate
+    // Both Data rate and off time are components of resources
+    // Configure data rate (bps)
+    onoff->SetAttribute("DataRate", DataRateValue(DataRate(dataRate)));
+
+    // // Configure packet size
+    uint32_t pktSize = 1024;
+    onoff->SetAttribute("PacketSize", UintegerValue(pktSize));
+
+    // Configure sender node
+    onoff->SetAttribute("Remote", AddressValue(InetSocketAddress(remoteAddr, parent->port)));
+
+    node->AddApplication(onoff);
+    onoff->SetStartTime(Seconds(0.0));
+    onoff->SetStopTime(Seconds(parent->simulationTime));
+
+    receiver.configureAsReceiver(parent);
+
+    // Tx fires once the socket sent its own copy, so class goes on the socket (created on
+    // start, and the first packet leaves an interval later) and send time in a header
+    onoff->SetAttribute("EnableSeqTsSizeHeader", BooleanValue(true));
+    Simulator::Schedule(TimeStep(1), &FlowClassTag::markSocket, flowClass, onoff);
+
+    // Mark packets with flow class, then count them (sinks are called in this order)
+    onoff->TraceConnectWithoutContext("Tx", MakeBoundCallback(&FlowClassTag::mark, flowClass));
+    onoff->TraceConnectWithoutContext("Tx", MakeCallback(&ClusterNode::OnPacketSent, this));
+
+    return ApplicationContainer(onoff);
+}
+
+NS_OBJECT_ENSURE_REGISTERED(MultiFlowOnOffApplication);
+
+TypeId MultiFlowOnOffApplication::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::MultiFlowOnOffApplication")
+                            .SetParent<Application>()
+                            .SetGroupName("Applications")
+                            .AddConstructor<MultiFlowOnOffApplication>()
+                            .AddAttribute("PacketSize", "Size of packets sent by every flow",
+                                          UintegerValue(1024),
+                                          MakeUintegerAccessor(&MultiFlowOnOffApplication::packetSize),
+                                          MakeUintegerChecker<uint32_t>(1))
+                            .AddTraceSource("Tx", "A new packet is created and is sent",
+                                            MakeTraceSourceAccessor(&MultiFlowOnOffApplication::txTrace),
+                                            "ns3::Packet::TracedCallback");
+    return tid;
+}
+
+MultiFlowOnOffApplication::MultiFlowOnOffApplication()
+    : running(false),
+      packetSize(1024)
+{
+    random = CreateObject<ExponentialRandomVariable>();
+}
+
+// Add a flow, returns its index
+uint32_t MultiFlowOnOffApplication::addFlow(
+    Ipv4Address remote, uint16_t port, DataRate rate, double meanOnTime, double meanOffTime, uint8_t flowClass)
+{
+    uint32_t flow = remoteAddresses.size();
+
+    remoteAddresses.push_back(remote.Get());
+    remotePorts.push_back(port);
+    intervals.push_back(std::max<int64_t>(1, rate.CalculateBytesTxTime(packetSize).GetTimeStep()));
+    meanOnTimes.push_back(meanOnTime);
+    meanOffTimes.push_back(meanOffTime);
+    periodEnds.push_back(0);
+    isOn.push_back(false);
+    flowClasses.push_back(flowClass);
+
+    // Flows added while running start right away (with an off period, like OnOffApplication)
+    if (running)
+    {
+        int64_t now = Simulator::Now().GetTimeStep();
+        periodEnds[flow] = now + Seconds(random->GetValue(meanOffTimes[flow], 0)).GetTimeStep();
+        pending.push(std::make_pair(periodEnds[flow], flow));
+        scheduleNext();
+    }
+
+    return flow;
+}
+
+// Number of flows
+uint32_t MultiFlowOnOffApplication::getNFlows() const
+{
+    return remoteAddresses.size();
+}
+
+// Fix random streams, returns how many were used
+int64_t MultiFlowOnOffApplication::AssignStreams(int64_t stream)
+{
+    random->SetStream(stream);
+    return 1;
+}
+
+void MultiFlowOnOffApplication::DoDispose()
+{
+    socket = NULL;
+    templatePacket = NULL;
+    Application::DoDispose();
+}
+
+void MultiFlowOnOffApplication::StartApplication()
+{
+    if (!socket)
+    {
+        socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+        socket->Bind();
+        socket->SetAllowBroadcast(false);
+    }
+
+    // Every packet is a copy of this one (copies share the buffer)
+    templatePacket = Create<Packet>(packetSize);
+    running = true;
+
+    // Every flow starts with an off period
+    int64_t now = Simulator::Now().GetTimeStep();
+    for (uint32_t flow = 0; flow < remoteAddresses.size(); flow++)
+    {
+        isOn[flow] = false;
+        periodEnds[flow] = now + Seconds(random->GetValue(meanOffTimes[flow], 0)).GetTimeStep();
+        pending.push(std::make_pair(periodEnds[flow], flow));
+    }
+
+    scheduleNext();
+}
+
+void MultiFlowOnOffApplication::StopApplication()
+{
+    running = false;
+    Simulator::Cancel(nextEvent);
+
+    pending = std::priority_queue<std::pair<int64_t, uint32_t>, std::vector<std::pair<int64_t, uint32_t>>,
+                                  std::greater<std::pair<int64_t, uint32_t>>>();
+
+    if (socket)
+        socket->Close();
+}
+
+// Schedule simulator event for the earliest flow
+void MultiFlowOnOffApplication::scheduleNext()
+{
+    if (pending.empty())
+        return;
+
+    Time when = TimeStep(pending.top().first);
+
+    // Earliest flow changed, move the event
+    if (nextEvent.IsRunning())
+    {
+        if (nextEvent.GetTs() <= (uint64_t)pending.top().first)
+            return;
+
+        Simulator::Cancel(nextEvent);
+    }
+
+    nextEvent = Simulator::Schedule(when - Simulator::Now(), &MultiFlowOnOffApplication::handleEvents, this);
+}
+
+// Process due flows and schedule the next one
+void MultiFlowOnOffApplication::handleEvents()
+{
+    int64_t now = Simulator::Now().GetTimeStep();
+
+    while (!pending.empty() && pending.top().first <= now)
+    {
+        uint32_t flow = pending.top().second;
+        pending.pop();
+
+        int64_t next;
+
+        if (now >= periodEnds[flow])
+        {
+            // Period ended, switch state
+            isOn[flow] = !isOn[flow];
+            double mean = isOn[flow] ? meanOnTimes[flow] : meanOffTimes[flow];
+            periodEnds[flow] = now + Seconds(random->GetValue(mean, 0)).GetTimeStep();
+
+            // First packet of an on period leaves after an interval, as in OnOffApplication
+            next = isOn[flow] ? std::min(now + intervals[flow], periodEnds[flow]) : periodEnds[flow];
+        }
+        else
+        {
+            // Still on, send a packet
+            Ptr<Packet> packet = templatePacket->Copy();
+            FlowClassTag::mark(flowClasses[flow], packet);
+            txTrace(packet);
+            socket->SendTo(packet, 0, InetSocketAddress(Ipv4Address(remoteAddresses[flow]), remotePorts[flow]));
+
+            next = std::min(now + intervals[flow], periodEnds[flow]);
+        }
+
+        pending.push(std::make_pair(next, flow));
+    }
+
+    scheduleNext();
+}
+
+// Configure node as receiver
+void ClusterNode::configureAsReceiver(Taller1Experiment *_parent)
+{
+    parent = _parent;
+
+    // Every flow reaching this node shares the same sink
+    parent->getSink(node);
+}
+
+// Callback for packet sent BY node
+void ClusterNode::OnPacketSent(Ptr<const Packet> packet)
+{
+    parent->sentCount++; // Propagate callback to parent
+
+    FlowClassTag tag;
+    if (packet->FindFirstMatchingByteTag(tag))
+        parent->flowClasses[tag.flowClass].sent++;
+}
+
+const char *FlowClassTag::classNames[FlowClassTag::N_CLASSES] = {"be", "bk", "vi", "vo"};
+const uint8_t FlowClassTag::classTos[FlowClassTag::N_CLASSES] = {0x00, 0x20, 0xa0, 0xc0};
+
+// Class of a name (be, bk, vi, vo), N_CLASSES if unknown
+int FlowClassTag::fromName(std::string name)
+{
+    int c = 0;
+    while (c < N_CLASSES && name != classNames[c])
+        c++;
+
+    return c;
+}
+
+// Class of a ToS (by user priority, be if no class has it)
+uint8_t FlowClassTag::fromTos(uint8_t tos)
+{
+    for (uint8_t c = 0; c < N_CLASSES; c++)
+    {
+        if (classTos[c] >> 5 == tos >> 5)
+            return c;
+    }
+
+    return BE;
+}
+
+FlowClassTag::FlowClassTag(uint8_t _flowClass, Time time)
+    : flowClass(_flowClass),
+      sendTime(time.GetTimeStep())
+{
+}
+
+// Mark a packet about to be sent with a class (this tag, ToS and priority)
+void FlowClassTag::mark(uint8_t flowClass, Ptr<const Packet> packet)
+{
+    packet->AddByteTag(FlowClassTag(flowClass, Simulator::Now()));
+
+    // Sockets without ToS of their own leave these tags alone
+    SocketIpTosTag tos;
+    tos.SetTos(classTos[flowClass]);
+    packet->AddPacketTag(tos);
+
+    SocketPriorityTag priority;
+    priority.SetPriority(classTos[flowClass] >> 5);
+    packet->AddPacketTag(priority);
+}
+
+// Give the socket of an OnOffApplication ToS and priority of a class
+void FlowClassTag::markSocket(uint8_t flowClass, Ptr<OnOffApplication> application)
+{
+    Ptr<Socket> socket = application->GetSocket();
+    NS_ABORT_MSG_IF(!socket, "OnOffApplication has no socket to mark yet");
+
+    // SetIpTos sets a priority of its own
+    socket->SetIpTos(classTos[flowClass]);
+    socket->SetPriority(classTos[flowClass] >> 5);
+}
+
+NS_OBJECT_ENSURE_REGISTERED(FlowClassTag);
+
+TypeId FlowClassTag::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::FlowClassTag")
+                            .SetParent<Tag>()
+                            .SetGroupName("Applications")
+                            .AddConstructor<FlowClassTag>();
+    return tid;
+}
+
+TypeId FlowClassTag::GetInstanceTypeId() const
+{
+    return GetTypeId();
+}
+
+uint32_t FlowClassTag::GetSerializedSize() const
+{
+    return 9;
+}
+
+void FlowClassTag::Serialize(TagBuffer buffer) const
+{
+    buffer.WriteU8(flowClass);
+    buffer.WriteU64(sendTime);
+}
+
+void FlowClassTag::Deserialize(TagBuffer buffer)
+{
+    flowClass = buffer.ReadU8();
+    sendTime = buffer.ReadU64();
+}
+
+void FlowClassTag::Print(std::ostream &os) const
+{
+    os << "class=" << classNames[flowClass] << " sent=" << TimeStep(sendTime);
+}
+
+FlowSink::FlowSink(Ptr<Node> node, uint16_t port, Taller1Experiment *_parent)
+{
+    parent = _parent;
+
+    // Configure packet sink tracker
+    socket = Socket::CreateSocket(node, UdpSocketFactory::GetTypeId());
+
+    Ipv4Address localAddr = node->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+    socket->Bind(InetSocketAddress(localAddr, port));
+    socket->SetIpRecvTos(true);
+    socket->SetRecvCallback(MakeCallback(&FlowSink::receivePacket, this));
+}
+
+// Callback for packet received BY node
+void FlowSink::receivePacket(Ptr<Socket> _socket)
+{
+    Address from;
+    Ptr<Packet> packet;
+
+    // Multiple packets could have reached, they must be "read" by means of RecvFrom()
+    while ((packet = _socket->RecvFrom(from)))
+    {
+        InetSocketAddress source = InetSocketAddress::ConvertFrom(from);
+        uint64_t key = (uint64_t)source.GetIpv4().Get() << 16 | source.GetPort();
+
+        // New source gets the next flow id
+        std::unordered_map<uint64_t, uint32_t>::iterator flowId = flowIds.find(key);
+        if (flowId == flowIds.end())
+        {
+            flowId = flowIds.insert(std::make_pair(key, (uint32_t)flows.size())).first;
+            flows.push_back(FlowCounters());
+        }
+
+        FlowCounters &counters = flows[flowId->second];
+        counters.packets++;
+        counters.bytes += packet->GetSize();
+
+        parent->receivedCount++; // Propagate callback to parent
+        parent->receivedBytes += packet->GetSize();
+
+        // Latency by traffic class (OnOffApplication packets carry class in ToS and send
+        // time in a header instead)
+        FlowClassTag tag;
+        SocketIpTosTag tos;
+        bool classified = packet->FindFirstMatchingByteTag(tag);
+        if (!classified && parent->trafficApplication == "onoff" && packet->PeekPacketTag(tos))
+        {
+            SeqTsSizeHeader header;
+            packet->PeekHeader(header);
+            tag = FlowClassTag(FlowClassTag::fromTos(tos.GetTos()), header.GetTs());
+            classified = true;
+        }
+
+        if (classified)
+        {
+            Taller1Experiment::ClassCounters &classCounters = parent->flowClasses[tag.flowClass];
+            classCounters.received++;
+            classCounters.bytes += packet->GetSize();
+            classCounters.latencyUs.add((Simulator::Now() - TimeStep(tag.sendTime)).GetMicroSeconds());
+
+            uint32_t interval = parent->earlyStopInterval > 0 ? TimeStep(tag.sendTime).GetSeconds() / parent->earlyStopInterval : 0;
+            if (parent->receivedBySendInterval.size() <= interval)
+                parent->receivedBySendInterval.resize(interval + 1);
+            parent->receivedBySendInterval[interval]++;
+        }
+    }
+}
+
+// Trace sink for wifi queues of an access category (queue class), counts class packets
+// queued in the wrong one
+void ClassQueued(Taller1Experiment *parent, uint8_t queueClass, Ptr<const WifiMacQueueItem> item)
+{
+    FlowClassTag tag;
+    if (item->GetPacket()->FindFirstMatchingByteTag(tag) && tag.flowClass != queueClass)
+        parent->flowClasses[tag.flowClass].misqueued++;
+}
+
+// Packets received by half of the run
+void Taller1Experiment::markHalfTime()
+{
+    halfTimeReceived = receivedCount;
+}
+
+// Get sink of a node, creating it the first time
+FlowSink &Taller1Experiment::getSink(Ptr<Node> node)
+{
+    std::shared_ptr<FlowSink> &sink = sinks[node->GetId()];
+
+    if (!sink)
+        sink = std::make_shared<FlowSink>(node, port, this);
+
+    return *sink;
+}
+
+// Create nodes contaner with specified number of nodes
+Cluster::Cluster(int _index)
+{
+    // Save cluster index, useful for some tricks like SSID assignation
+    index = _index;
+}
+
+// Generate nodes when there are not nodes available
+void Cluster::generateNodes(int nNodes)
+{
+    // Create nodes
+    ns3Nodes.Create(nNodes);
+}
+
+// Save data from existent nodes
+void Cluster::setNodes(NodeContainer _nodes)
+{
+    ns3Nodes = _nodes;
+}
+
+// Create cluster nodes (here we will save some useful data, like node's resources)
+void Cluster::createClusterNodes(double trafficRatio, double totalResouces, double probability)
+{
+    int length = ns3Nodes.GetN();
+
+    for (int j = 0; j < length; j++)
+    {
+        // Get resources for node
+        double nodeResources = TruncatedDistribution(
+            length, totalResouces, probability, j);
+
+        nodes.push_back(ClusterNode(j, true, trafficRatio, nodeResources, ns3Nodes.Get(j)));
+    }
+}
+
+// Set cluster head (comes from level container)
+void Cluster::separateHead(uint32_t headIndex)
+{
+    Ptr<Node> head = ns3Nodes.Get(headIndex);
+
+    // Refactor containers to have consistency
+    for (uint32_t i = 0; i < ns3Nodes.GetN(); i++)
+    {
+        if (i == headIndex)
+            continue;
+
+        ns3NodesExcludingHead.Add(ns3Nodes.Get(i));
+    }
+
+    // Update head-only container
+    headContainer.Add(head);
+}
+
+// Calculate expected resources for this cluster
+double Cluster::getResources()
+{
+    double resources = 0;
+
+    for (ClusterNode node : nodes)
+    {
+        resources += node.getResources();
+    }
+
+    return resources;
+}
+
+// Calculate level resources
+double Level::getResources()
+{
+    double resources = 0;
+
+    for (Cluster cluster : clusters)
+    {
+        resources += cluster.getResources();
+    }
+
+    return resources;
+}
+
+// Truncated distribution assigner
+double
+TruncatedDistribution(
+    int nPoints, double totalResources, double probability, int nodeIndex)
+{
+    // Here joins probability density function for truncated geometric distribution
+    // Portion of total resources this node will take
+
+    double portion = probability * pow(1 - probability, nodeIndex) / (1 - pow(1 - probability, nPoints));
+    // Return resources to assign to node
+    return portion * totalResources;
+}
+
+PrefixTrie::PrefixTrie()
+{
+    clear();
+}
+
+uint32_t PrefixTrie::maskOf(uint8_t length)
+{
+    return length == 0 ? 0 : 0xffffffff << (32 - length);
+}
+
+int PrefixTrie::bitAt(uint32_t x, uint8_t position)
+{
+    return (x >> (31 - position)) & 1;
+}
+
+int32_t PrefixTrie::newNode(uint32_t prefix, uint8_t length)
+{
+    TrieNode node = {prefix & maskOf(length), length, false, 0, {-1, -1}};
+
+    if (!freeNodes.empty())
+    {
+        int32_t index = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[index] = node;
+        return index;
+    }
+
+    nodes.push_back(node);
+    return nodes.size() - 1;
+}
+
+// Remove every prefix
+void PrefixTrie::clear()
+{
+    nodes.clear();
+    freeNodes.clear();
+    nPrefixes = 0;
+
+    // Root covers no bits at all
+    newNode(0, 0);
+}
+
+uint32_t PrefixTrie::size() const
+{
+    return nPrefixes;
+}
+
+// Insert a prefix (replacing its value if already there)
+void PrefixTrie::insert(uint32_t prefix, uint8_t length, uint32_t value)
+{
+    prefix &= maskOf(length);
+    int32_t current = 0;
+
+    while (nodes[current].length < length)
+    {
+        int bit = bitAt(prefix, nodes[current].length);
+        int32_t next = nodes[current].child[bit];
+
+        // Nothing below, prefix becomes a leaf
+        if (next < 0)
+        {
+            int32_t leaf = newNode(prefix, length);
+            nodes[current].child[bit] = leaf;
+            current = leaf;
+            break;
+        }
+
+        // Bits shared by the new prefix and the child
+        uint8_t childLength = nodes[next].length;
+        uint32_t difference = (prefix ^ nodes[next].prefix) & maskOf(std::min(length, childLength));
+        uint8_t common = difference == 0 ? std::min(length, childLength) : __builtin_clz(difference);
+
+        if (common == childLength)
+        {
+            current = next;
+            continue;
+        }
+
+        // Child diverges before its end, split it with a node covering common bits
+        int32_t split = newNode(prefix, common);
+        nodes[split].child[bitAt(nodes[next].prefix, common)] = next;
+        nodes[current].child[bit] = split;
+        current = split;
+
+        if (common < length)
+        {
+            int32_t leaf = newNode(prefix, length);
+            nodes[split].child[bitAt(prefix, common)] = leaf;
+            current = leaf;
+        }
+        break;
+    }
+
+    if (!nodes[current].hasValue)
+        nPrefixes++;
+
+    nodes[current].hasValue = true;
+    nodes[current].value = value;
+}
+
+// Remove a prefix, returns whether it was there
+bool PrefixTrie::remove(uint32_t prefix, uint8_t length)
+{
+    prefix &= maskOf(length);
+    int32_t parent = -1, current = 0;
+
+    while (nodes[current].length < length)
+    {
+        int32_t next = nodes[current].child[bitAt(prefix, nodes[current].length)];
+
+        if (next < 0 || nodes[next].length > length || ((prefix ^ nodes[next].prefix) & maskOf(nodes[next].length)) != 0)
+            return false;
+
+        parent = current;
+        current = next;
+    }
+
+    if (nodes[current].length != length || !nodes[current].hasValue)
+        return false;
+
+    nodes[current].hasValue = false;
+    nPrefixes--;
+
+    // Keep the trie compressed, nodes without value need two children
+    // (root is always kept)
+    if (parent >= 0)
+    {
+        int nChildren = (nodes[current].child[0] >= 0) + (nodes[current].child[1] >= 0);
+
+        if (nChildren < 2)
+        {
+            int32_t replacement = nodes[current].child[0] >= 0 ? nodes[current].child[0] : nodes[current].child[1];
+            int parentBit = nodes[parent].child[0] == current ? 0 : 1;
+
+            nodes[parent].child[parentBit] = replacement;
+            freeNodes.push_back(current);
+        }
+    }
+
+    return true;
+}
+
+// Find value of exactly this prefix
+bool PrefixTrie::find(uint32_t prefix, uint8_t length, uint32_t &value) const
+{
+    prefix &= maskOf(length);
+    int32_t current = 0;
+
+    while (nodes[current].length < length)
+    {
+        int32_t next = nodes[current].child[bitAt(prefix, nodes[current].length)];
+
+        if (next < 0 || nodes[next].length > length || ((prefix ^ nodes[next].prefix) & maskOf(nodes[next].length)) != 0)
+            return false;
+
+        current = next;
+    }
+
+    if (!nodes[current].hasValue)
+        return false;
+
+    value = nodes[current].value;
+    return true;
+}
+
+// Find value of the longest prefix containing address
+bool PrefixTrie::lookup(uint32_t address, uint32_t &value) const
+{
+    bool found = false;
+    int32_t current = 0;
+
+    while (true)
+    {
+        const TrieNode &node = nodes[current];
+
+        if (node.hasValue)
+        {
+            found = true;
+            value = node.value;
+        }
+
+        if (node.length == 32)
+            break;
+
+        int32_t next = node.child[bitAt(address, node.length)];
+        if (next < 0 || ((address ^ nodes[next].prefix) & maskOf(nodes[next].length)) != 0)
+            break;
+
+        current = next;
+    }
+
+    return found;
+}
+
+NS_OBJECT_ENSURE_REGISTERED(TrieRouting);
+
+TypeId TrieRouting::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::TrieRouting")
+                            .SetParent<Ipv4RoutingProtocol>()
+                            .SetGroupName("Internet")
+                            .AddConstructor<TrieRouting>();
+    return tid;
+}
+
+// Add a route to a network (replaces any route to the same network)
+void TrieRouting::AddNetworkRouteTo(
+    Ipv4Address network, Ipv4Mask mask, Ipv4Address gateway, uint32_t interface, uint32_t metric)
+{
+    uint8_t length = mask.GetPrefixLength();
+    uint32_t index;
+
+    // Reuse the entry already pointing to this network
+    if (trie.find(network.Get(), length, index))
+    {
+        routes[index] = {network.CombineMask(mask), mask, gateway, interface, metric, true};
+        return;
+    }
+
+    if (!freeRoutes.empty())
+    {
+        index = freeRoutes.back();
+        freeRoutes.pop_back();
+        routes[index] = {network.CombineMask(mask), mask, gateway, interface, metric, true};
+    }
+    else
+    {
+        index = routes.size();
+        routes.push_back({network.CombineMask(mask), mask, gateway, interface, metric, true});
+    }
+
+    trie.insert(network.Get(), length, index);
+}
+
+// Add a route to 0.0.0.0/0
+void TrieRouting::SetDefaultRoute(Ipv4Address gateway, uint32_t interface, uint32_t metric)
+{
+    AddNetworkRouteTo(Ipv4Address::GetAny(), Ipv4Mask::GetZero(), gateway, interface, metric);
+}
+
+// Remove route to a network, returns whether it existed
+bool TrieRouting::RemoveNetworkRoute(Ipv4Address network, Ipv4Mask mask)
+{
+    uint32_t index;
+
+    if (!trie.find(network.Get(), mask.GetPrefixLength(), index))
+        return false;
+
+    trie.remove(network.Get(), mask.GetPrefixLength());
+    routes[index].active = false;
+    freeRoutes.push_back(index);
+
+    return true;
+}
+
+// Remove routes added with a given metric, returns how many were removed
+uint32_t TrieRouting::RemoveRoutesWithMetric(uint32_t metric)
+{
+    uint32_t nRemoved = 0;
+
+    for (uint32_t i = 0; i < routes.size(); i++)
+    {
+        if (!routes[i].active || routes[i].metric != metric)
+            continue;
+
+        trie.remove(routes[i].network.Get(), routes[i].mask.GetPrefixLength());
+        routes[i].active = false;
+        freeRoutes.push_back(i);
+        nRemoved++;
+    }
+
+    return nRemoved;
+}
+
+// Number of routes in the table
+uint32_t TrieRouting::GetNRoutes() const
+{
+    return trie.size();
+}
+
+// Route (if any) for a destination
+Ptr<Ipv4Route> TrieRouting::lookup(Ipv4Address destination, Ptr<NetDevice> oif)
+{
+    uint32_t index;
+
+    if (!trie.lookup(destination.Get(), index))
+        return NULL;
+
+    const TrieRoute &entry = routes[index];
+
+    // Routes can't be used when they leave through another device
+    if (oif && ipv4->GetNetDevice(entry.interface) != oif)
+        return NULL;
+
+    Ptr<Ipv4Route> route = Create<Ipv4Route>();
+    route->SetDestination(destination);
+    route->SetGateway(entry.gateway);
+    route->SetSource(ipv4->GetAddress(entry.interface, 0).GetLocal());
+    route->SetOutputDevice(ipv4->GetNetDevice(entry.interface));
+
+    return route;
+}
+
+Ptr<Ipv4Route> TrieRouting::RouteOutput(
+    Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr)
+{
+    Ipv4Address destination = header.GetDestination();
+
+    // Multicast and broadcast are left to other protocols in the list
+    if (destination.IsMulticast() || destination.IsBroadcast())
+    {
+        sockerr = Socket::ERROR_NOROUTETOHOST;
+        return NULL;
+    }
+
+    Ptr<Ipv4Route> route = lookup(destination, oif);
+    sockerr = route ? Socket::ERROR_NOTERROR : Socket::ERROR_NOROUTETOHOST;
+
+    return route;
+}
+
+bool TrieRouting::RouteInput(
+    Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev,
+    UnicastForwardCallback ucb, MulticastForwardCallback mcb, LocalDeliverCallback lcb, ErrorCallback ecb)
+{
+    uint32_t iif = ipv4->GetInterfaceForDevice(idev);
+    Ipv4Address destination = header.GetDestination();
+
+    if (destination.IsMulticast())
+        return false;
+
+    // Local delivery (Ipv4ListRouting already did it when lcb is null)
+    if (ipv4->IsDestinationAddress(destination, iif))
+    {
+        if (lcb.IsNull())
+            return false;
+
+        lcb(p, header, iif);
+        return true;
+    }
+
+    if (!ipv4->IsForwarding(iif))
+    {
+        ecb(p, header, Socket::ERROR_NOROUTETOHOST);
+        return true;
+    }
+
+    Ptr<Ipv4Route> route = lookup(destination, NULL);
+    if (!route)
+        return false;
+
+    ucb(route, p, header);
+    return true;
+}
+
+// Connected networks get a route without gateway
+void TrieRouting::NotifyInterfaceUp(uint32_t interface)
+{
+    for (uint32_t j = 0; j < ipv4->GetNAddresses(interface); j++)
+        NotifyAddAddress(interface, ipv4->GetAddress(interface, j));
+}
+
+void TrieRouting::NotifyInterfaceDown(uint32_t interface)
+{
+    for (uint32_t i = 0; i < routes.size(); i++)
+    {
+        if (routes[i].active && routes[i].interface == interface)
+        {
+            trie.remove(routes[i].network.Get(), routes[i].mask.GetPrefixLength());
+            routes[i].active = false;
+            freeRoutes.push_back(i);
+        }
+    }
+}
+
+void TrieRouting::NotifyAddAddress(uint32_t interface, Ipv4InterfaceAddress address)
+{
+    // Loopback is handled by local delivery
+    if (address.GetLocal() == Ipv4Address::GetLoopback() || !ipv4->IsUp(interface))
+        return;
+
+    AddNetworkRouteTo(address.GetLocal().CombineMask(address.GetMask()), address.GetMask(), Ipv4Address::GetZero(), interface);
+}
+
+void TrieRouting::NotifyRemoveAddress(uint32_t interface, Ipv4InterfaceAddress address)
+{
+    RemoveNetworkRoute(address.GetLocal().CombineMask(address.GetMask()), address.GetMask());
+}
+
+void TrieRouting::SetIpv4(Ptr<Ipv4> _ipv4)
+{
+    ipv4 = _ipv4;
+
+    for (uint32_t i = 0; i < ipv4->GetNInterfaces(); i++)
+    {
+        if (ipv4->IsUp(i))
+            NotifyInterfaceUp(i);
+    }
+}
+
+void TrieRouting::PrintRoutingTable(Ptr<OutputStreamWrapper> stream, Time::Unit unit) const
+{
+    std::ostream *os = stream->GetStream();
+
+    *os << "Node: " << ipv4->GetObject<Node>()->GetId()
+        << ", Time: " << Now().As(unit)
+        << ", TrieRouting table (" << trie.size() << " routes)" << std::endl;
+
+    for (const TrieRoute &route : routes)
+    {
+        if (route.active)
+            *os << route.network << "/" << route.mask.GetPrefixLength() << " via " << route.gateway
+                << " if " << route.interface << " metric " << route.metric << std::endl;
+    }
+}
+
+void TrieRouting::DoDispose()
+{
+    ipv4 = NULL;
+    Ipv4RoutingProtocol::DoDispose();
+}
+
+TrieRoutingHelper *TrieRoutingHelper::Copy() const
+{
+    return new TrieRoutingHelper(*this);
+}
+
+Ptr<Ipv4RoutingProtocol> TrieRoutingHelper::Create(Ptr<Node> node) const
+{
+    return CreateObject<TrieRouting>();
+}
+
+// Find TrieRouting on a node (directly or inside a list), null if there isn't any
+Ptr<TrieRouting> TrieRoutingHelper::GetTrieRouting(Ptr<Ipv4> ipv4)
+{
+    return FindRoutingProtocol<TrieRouting>(ipv4);
+}
+
+// Gateway with the fewest frames waiting on its uplink (then fewest destinations)
+uint32_t GatewayGroup::leastLoaded() const
+{
+    uint32_t best = 0;
+    uint64_t bestQueued = UINT64_MAX;
+
+    for (uint32_t g = 0; g < uplinks.size(); g++)
+    {
+        // Wired uplinks only count destinations
+        uint64_t queued = 0;
+        Ptr<WifiNetDevice> wifiUplink = DynamicCast<WifiNetDevice>(uplinks[g]);
+        if (wifiUplink)
+        {
+            for (Ptr<WifiMacQueue> queue : DeviceQueues(wifiUplink))
+                queued += queue->GetNPackets();
+        }
+
+        if (queued < bestQueued || (queued == bestQueued && destinations[g] < destinations[best]))
+        {
+            best = g;
+            bestQueued = queued;
+        }
+    }
+
+    return best;
+}
+
+NS_OBJECT_ENSURE_REGISTERED(GatewaySelectionRouting);
+
+TypeId GatewaySelectionRouting::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::GatewaySelectionRouting")
+                            .SetParent<Ipv4RoutingProtocol>()
+                            .SetGroupName("Internet")
+                            .AddConstructor<GatewaySelectionRouting>();
+    return tid;
+}
+
+Ptr<Ipv4Route> GatewaySelectionRouting::RouteOutput(
+    Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr)
+{
+    Ipv4Address destination = header.GetDestination();
+    sockerr = Socket::ERROR_NOROUTETOHOST;
+
+    // Members reach the cluster through their first interface (a station), and gateways
+    // through the second one (ad hoc)
+    Ipv4InterfaceAddress local = ipv4->GetAddress(1, 0);
+    if (destination.IsMulticast() || destination.IsBroadcast() || destination.IsSubnetDirectedBroadcast(local.GetMask()) ||
+        destination.CombineMask(local.GetMask()) == local.GetLocal().CombineMask(local.GetMask()))
+        return NULL;
+
+    uint32_t gateway;
+    if (policy == "hash")
+    {
+        uint32_t addresses[2] = {local.GetLocal().Get(), destination.Get()};
+        gateway = Hash32((const char *)addresses, sizeof(addresses)) % group->addresses.size();
+    }
+    else
+    {
+        std::unordered_map<uint32_t, uint32_t>::iterator it = assigned.find(destination.Get());
+        if (it == assigned.end())
+        {
+            it = assigned.insert(std::make_pair(destination.Get(), group->leastLoaded())).first;
+            group->destinations[it->second]++;
+        }
+        gateway = it->second;
+    }
+
+    group->packets[gateway]++;
+
+    Ptr<Ipv4Route> route = Create<Ipv4Route>();
+    route->SetDestination(destination);
+    route->SetGateway(group->addresses[gateway]);
+    route->SetSource(local.GetLocal());
+    route->SetOutputDevice(ipv4->GetNetDevice(2));
+
+    sockerr = Socket::ERROR_NOTERROR;
+    return route;
+}
+
+bool GatewaySelectionRouting::RouteInput(
+    Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev,
+    UnicastForwardCallback ucb, MulticastForwardCallback mcb, LocalDeliverCallback lcb, ErrorCallback ecb)
+{
+    return false;
+}
+
+void GatewaySelectionRouting::SetIpv4(Ptr<Ipv4> _ipv4)
+{
+    ipv4 = _ipv4;
+}
+
+void GatewaySelectionRouting::PrintRoutingTable(Ptr<OutputStreamWrapper> stream, Time::Unit unit) const
+{
+    std::ostream *os = stream->GetStream();
+
+    *os << "Node: " << ipv4->GetObject<Node>()->GetId()
+        << ", Time: " << Now().As(unit)
+        << ", GatewaySelectionRouting (" << policy << ", " << group->addresses.size() << " gateways)" << std::endl;
+
+    for (uint32_t g = 0; g < group->addresses.size(); g++)
+        *os << group->addresses[g] << "\t" << group->packets[g] << " packets" << std::endl;
+}
+
+void GatewaySelectionRouting::DoDispose()
+{
+    ipv4 = NULL;
+    Ipv4RoutingProtocol::DoDispose();
+}
+
+// Trace sinks, they forward to the tracker
+void OlsrOverheadTx(OlsrOverheadTracker *tracker, Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface)
+{
+    tracker->onPacket(true, packet, ipv4, interface);
+}
+
+void OlsrOverheadRx(OlsrOverheadTracker *tracker, Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface)
+{
+    tracker->onPacket(false, packet, ipv4, interface);
+}
+
+const char *DropTracker::causeNames[DropTracker::N_CAUSES] = {
+    "phyRx", "phyOverheard", "phyTx", "macTx", "macRetry", "wifiQueue", "queueDisc", "noRoute", "ttlExpired", "ipOther"};
+
+uint64_t DropTracker::Counters::total() const
+{
+    return std::accumulate(drops, drops + N_CAUSES, (uint64_t)0);
+}
+
+// Trace sinks with drop source bound
+void DropPhyRx(DropTracker::Source *source, Ptr<const Packet> packet, WifiPhyRxfailureReason reason)
+{
+    // Every frame heard is reported, losing one meant for another station isn't a loss here
+    WifiMacHeader header;
+    packet->PeekHeader(header);
+    bool addressed = header.GetAddr1().IsGroup() || header.GetAddr1() == source->address;
+
+    source->tracker->count(source->nodeId, source->level, addressed ? DropTracker::PHY_RX : DropTracker::PHY_OVERHEARD);
+}
+
+void DropPhyTx(DropTracker::Source *source, Ptr<const Packet> packet)
+{
+    source->tracker->count(source->nodeId, source->level, DropTracker::PHY_TX);
+}
+
+void DropMacTx(DropTracker::Source *source, Ptr<const Packet> packet)
+{
+    source->tracker->count(source->nodeId, source->level, DropTracker::MAC_TX);
+}
+
+void DropMacRetry(DropTracker::Source *source, Mac48Address address)
+{
+    source->tracker->count(source->nodeId, source->level, DropTracker::MAC_RETRY);
+}
+
+void DropWifiQueue(DropTracker::Source *source, Ptr<const WifiMacQueueItem> item)
+{
+    source->tracker->count(source->nodeId, source->level, DropTracker::WIFI_QUEUE);
+}
+
+void DropQueueDisc(DropTracker::Source *source, Ptr<const QueueDiscItem> item)
+{
+    source->tracker->count(source->nodeId, source->level, DropTracker::QUEUE_DISC);
+}
+
+void DropIpv4(DropTracker::Source *source, const Ipv4Header &header, Ptr<const Packet> packet,
+              Ipv4L3Protocol::DropReason reason, Ptr<Ipv4> ipv4, uint32_t interface)
+{
+    DropTracker::Cause cause = reason == Ipv4L3Protocol::DROP_NO_ROUTE       ? DropTracker::NO_ROUTE
+                               : reason == Ipv4L3Protocol::DROP_TTL_EXPIRED ? DropTracker::TTL_EXPIRED
+                                                                             : DropTracker::IP_OTHER;
+
+    // Level of incoming interface
+    uint32_t level = 0;
+    if (interface < ipv4->GetNInterfaces())
+    {
+        std::map<Ptr<NetDevice>, uint32_t>::iterator it = source->tracker->deviceLevels.find(ipv4->GetNetDevice(interface));
+        if (it != source->tracker->deviceLevels.end())
+            level = it->second;
+    }
+
+    source->tracker->count(source->nodeId, level, cause);
+}
+
+DropTracker::Source *DropTracker::addSource(uint32_t nodeId, uint32_t level)
+{
+    sources.push_back({this, nodeId, level});
+    return &sources.back();
+}
+
+// Connect to devices, queues and IPv4 of every level
+void DropTracker::install(std::vector<Level *> hierarchy)
+{
+    levels.resize(hierarchy.size() + 1);
+    std::set<uint32_t> connectedNodes;
+
+    for (uint32_t l = 0; l < hierarchy.size(); l++)
+    {
+        for (Cluster &cluster : hierarchy[l]->clusters)
+        {
+            for (uint32_t d = 0; d < cluster.ns3Devices.GetN(); d++)
+            {
+                Ptr<NetDevice> device = cluster.ns3Devices.Get(d);
+                Ptr<Node> node = device->GetNode();
+                Source *source = addSource(node->GetId(), l + 1);
+
+                deviceLevels[device] = l + 1;
+                nodes[node->GetId()];
+
+                Ptr<WifiNetDevice> wifiDevice = DynamicCast<WifiNetDevice>(device);
+                if (wifiDevice)
+                {
+                    source->address = Mac48Address::ConvertFrom(wifiDevice->GetAddress());
+                    wifiDevice->GetPhy()->TraceConnectWithoutContext("PhyRxDrop", MakeBoundCallback(&DropPhyRx, source));
+                    wifiDevice->GetPhy()->TraceConnectWithoutContext("PhyTxDrop", MakeBoundCallback(&DropPhyTx, source));
+                    wifiDevice->GetMac()->TraceConnectWithoutContext("MacTxDrop", MakeBoundCallback(&DropMacTx, source));
+                    wifiDevice->GetRemoteStationManager()->TraceConnectWithoutContext(
+                        "MacTxFinalDataFailed", MakeBoundCallback(&DropMacRetry, source));
+
+                    for (Ptr<WifiMacQueue> queue : DeviceQueues(wifiDevice))
+                    {
+                        queue->TraceConnectWithoutContext("Drop", MakeBoundCallback(&DropWifiQueue, source));
+                        queue->TraceConnectWithoutContext("Expired", MakeBoundCallback(&DropWifiQueue, source));
+                    }
+                }
+
+                Ptr<TrafficControlLayer> trafficControl = node->GetObject<TrafficControlLayer>();
+                Ptr<QueueDisc> queueDisc = trafficControl ? trafficControl->GetRootQueueDiscOnDevice(device) : NULL;
+                if (queueDisc)
+                    queueDisc->TraceConnectWithoutContext("Drop", MakeBoundCallback(&DropQueueDisc, source));
+
+                // Heads show up on several levels, but have a single IPv4
+                if (connectedNodes.insert(node->GetId()).second)
+                {
+                    node->GetObject<Ipv4L3Protocol>()->TraceConnectWithoutContext(
+                        "Drop", MakeBoundCallback(&DropIpv4, addSource(node->GetId(), 0)));
+                }
+            }
+        }
+    }
+}
+
+// Count a drop
+void DropTracker::count(uint32_t nodeId, uint32_t level, Cause cause)
+{
+    nodes[nodeId].drops[cause]++;
+    levels[level].drops[cause]++;
+}
+
+// Save counters on results (nodes only when they dropped something)
+void DropTracker::exportTo(SimulationResult &results)
+{
+    Counters all;
+
+    for (uint32_t l = 0; l < levels.size(); l++)
+    {
+        std::string prefix = "drops.lvl" + std::to_string(l) + ".";
+
+        for (int c = 0; c < N_CAUSES; c++)
+        {
+            results.stats[prefix + causeNames[c]] = levels[l].drops[c];
+            all.drops[c] += levels[l].drops[c];
+        }
+    }
+
+    for (int c = 0; c < N_CAUSES; c++)
+        results.stats[std::string("drops.") + causeNames[c]] = all.drops[c];
+
+    for (std::pair<const uint32_t, Counters> &node : nodes)
+    {
+        if (node.second.total() == 0)
+            continue;
+
+        std::string prefix = "drops.node" + std::to_string(node.first) + ".";
+        for (int c = 0; c < N_CAUSES; c++)
+        {
+            if (node.second.drops[c] > 0)
+                results.stats[prefix + causeNames[c]] = node.second.drops[c];
+        }
+    }
+}
+
+void Log2Histogram::add(double value)
+{
+    int bucket = value < 1 ? 0 : std::min(nBuckets - 1, 1 + (int)std::log2(value));
+
+    buckets[bucket]++;
+    count++;
+    sum += value;
+    max = std::max(max, value);
+}
+
+double Log2Histogram::mean() const
+{
+    return count > 0 ? sum / count : 0;
+}
+
+// Add every value of another histogram
+void Log2Histogram::merge(const Log2Histogram &other)
+{
+    for (int b = 0; b < nBuckets; b++)
+        buckets[b] += other.buckets[b];
+
+    count += other.count;
+    sum += other.sum;
+    max = std::max(max, other.max);
+}
+
+// Upper bound of the bucket holding the quantile
+double Log2Histogram::quantile(double q) const
+{
+    uint64_t needed = std::ceil(q * count), seen = 0;
+
+    for (int b = 0; b < nBuckets; b++)
+    {
+        seen += buckets[b];
+        if (seen >= needed && seen > 0)
+            return std::min(max, std::ldexp(1.0, b));
+    }
+
+    return max;
+}
+
+// Trace sink with channel stats bound
+void ChannelState(ChannelMonitor::ChannelStats *channel, Time start, Time duration, WifiPhyState state)
+{
+    channel->onState(start, duration, state);
+}
+
+// Account a state period of one phy
+// TX periods are reported as they start (with their whole duration), other states once
+// they end, so transmissions arrive sorted by start time
+void ChannelMonitor::ChannelStats::onState(Time start, Time duration, WifiPhyState state)
+{
+    if (state == WifiPhyState::RX)
+        rxTime += duration;
+    else if (state == WifiPhyState::CCA_BUSY)
+        ccaBusyTime += duration;
+
+    if (state != WifiPhyState::TX)
+        return;
+
+    txTime += duration;
+    transmissions++;
+
+    // Part of this transmission already covered by others
+    Time end = start + duration;
+    Time covered;
+    for (std::pair<Time, Time> &segment : segments)
+    {
+        if (segment.second > start && segment.first < end)
+            covered += std::min(segment.second, end) - std::max(segment.first, start);
+    }
+
+    overlap += covered;
+    airtime += duration - covered;
+    if (covered.IsStrictlyPositive())
+        collisions++;
+
+    // Merge into segments (disjoint, by start), transmissions are reported as they start
+    // so earlier ones may end after this one
+    while (!segments.empty() && segments.back().second >= start)
+    {
+        start = std::min(start, segments.back().first);
+        end = std::max(end, segments.back().second);
+        segments.pop_back();
+    }
+    segments.push_back(std::make_pair(start, end));
+
+    // No frame lasts this long, older segments can't overlap anything else
+    while (segments.front().second < end - Seconds(1))
+        segments.pop_front();
+}
+
+// Connect to phys of every level
+void ChannelMonitor::install(std::vector<Level *> hierarchy)
+{
+    for (uint32_t l = 0; l < hierarchy.size(); l++)
+    {
+        for (Cluster &cluster : hierarchy[l]->clusters)
+        {
+            for (uint32_t d = 0; d < cluster.ns3Devices.GetN(); d++)
+            {
+                Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice>(cluster.ns3Devices.Get(d));
+                if (!device)
+                    continue;
+
+                Ptr<Channel> key = device->GetChannel();
+                bool created = channels.find(key) == channels.end();
+
+                ChannelStats &channel = channels[key];
+                if (created)
+                {
+                    channel.index = channels.size() - 1;
+                    channel.level = l + 1;
+                }
+                channel.nPhys++;
+
+                device->GetPhy()->GetState()->TraceConnectWithoutContext(
+                    "State", MakeBoundCallback(&ChannelState, &channel));
+            }
+        }
+    }
+}
+
+// Save per channel and per level stats on results
+void ChannelMonitor::exportTo(SimulationResult &results, double seconds)
+{
+    struct LevelSummary
+    {
+        uint32_t nChannels = 0;
+        double busySum = 0, busyMax = 0;
+        uint64_t transmissions = 0, collisions = 0;
+    };
+    std::map<uint32_t, LevelSummary> levels;
+
+    for (std::pair<const Ptr<Channel>, ChannelStats> &entry : channels)
+    {
+        ChannelStats &channel = entry.second;
+        std::string prefix = "channel" + std::to_string(channel.index) + ".";
+        double phySeconds = seconds * channel.nPhys;
+        double busy = (channel.txTime + channel.rxTime + channel.ccaBusyTime).GetSeconds() / phySeconds;
+
+        results.stats[prefix + "level"] = channel.level;
+        results.stats[prefix + "phys"] = channel.nPhys;
+        results.stats[prefix + "busyFraction"] = busy;
+        results.stats[prefix + "txFraction"] = channel.txTime.GetSeconds() / phySeconds;
+        results.stats[prefix + "rxFraction"] = channel.rxTime.GetSeconds() / phySeconds;
+        results.stats[prefix + "ccaBusyFraction"] = channel.ccaBusyTime.GetSeconds() / phySeconds;
+        results.stats[prefix + "airtimeFraction"] = channel.airtime.GetSeconds() / seconds;
+        results.stats[prefix + "collisions"] = channel.collisions;
+        results.stats[prefix + "collisionFraction"] =
+            channel.transmissions > 0 ? channel.collisions / (double)channel.transmissions : 0;
+
+        LevelSummary &level = levels[channel.level];
+        level.nChannels++;
+        level.busySum += busy;
+        level.busyMax = std::max(level.busyMax, busy);
+        level.transmissions += channel.transmissions;
+        level.collisions += channel.collisions;
+    }
+
+    for (std::pair<const uint32_t, LevelSummary> &level : levels)
+    {
+        std::string prefix = "channels.lvl" + std::to_string(level.first) + ".";
+        LevelSummary &summary = level.second;
+
+        results.stats[prefix + "busyMean"] = summary.busySum / summary.nChannels;
+        results.stats[prefix + "busyMax"] = summary.busyMax;
+        results.stats[prefix + "collisionFraction"] =
+            summary.transmissions > 0 ? summary.collisions / (double)summary.transmissions : 0;
+
+        std::cout << "[Lvl " << level.first << "] Channels busy: " << summary.busySum / summary.nChannels
+                  << " mean, " << summary.busyMax << " max, collisions "
+                  << results.stats[prefix + "collisionFraction"] << " of transmissions" << std::endl;
+    }
+}
+
+// Trace sinks with head stats bound
+void HeadDequeue(HeadMonitor::HeadStats *head, Ptr<const WifiMacQueueItem> item)
+{
+    head->sojourn.add((Simulator::Now() - item->GetTimeStamp()).GetMicroSeconds());
+}
+
+void HeadForward(HeadMonitor *monitor, uint32_t nodeId, const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+{
+    std::map<uint32_t, HeadMonitor::HeadStats *> &heads = monitor->interfaces[nodeId];
+    std::map<uint32_t, HeadMonitor::HeadStats *>::iterator it = heads.find(interface);
+
+    if (it != heads.end())
+        it->second->forwarded++;
+}
+
+// Connect to heads of every level and sample queues each interval
+void HeadMonitor::install(std::vector<Level *> hierarchy, double _interval, double _stopTime)
+{
+    interval = _interval;
+    stopTime = _stopTime;
+    std::set<uint32_t> connectedNodes;
+
+    for (uint32_t l = 0; l < hierarchy.size(); l++)
+    {
+        for (Cluster &cluster : hierarchy[l]->clusters)
+        {
+            // On first level only the head (its AP device goes first)
+            uint32_t nDevices = l == 0 ? std::min<uint32_t>(1, cluster.ns3Devices.GetN()) : cluster.ns3Devices.GetN();
+
+            for (uint32_t d = 0; d < nDevices; d++)
+            {
+                Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice>(cluster.ns3Devices.Get(d));
+                if (!device)
+                    continue;
+
+                Ptr<Node> node = device->GetNode();
+                Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+
+                heads.push_back(HeadStats());
+                HeadStats &head = heads.back();
+                head.nodeId = node->GetId();
+                head.level = l + 1;
+                head.queues = DeviceQueues(device);
+                for (Ptr<WifiMacQueue> queue : head.queues)
+                    queue->TraceConnectWithoutContext("Dequeue", MakeBoundCallback(&HeadDequeue, &head));
+
+                interfaces[node->GetId()][ipv4->GetInterfaceForDevice(device)] = &head;
+
+                if (connectedNodes.insert(node->GetId()).second)
+                {
+                    node->GetObject<Ipv4L3Protocol>()->TraceConnectWithoutContext(
+                        "UnicastForward", MakeBoundCallback(&HeadForward, this, node->GetId()));
+                }
+            }
+        }
+    }
+
+    Simulator::Schedule(Seconds(interval), &HeadMonitor::sample, this);
+}
+
+// Sample queue lengths and schedule next sample
+void HeadMonitor::sample()
+{
+    for (HeadStats &head : heads)
+    {
+        uint32_t queued = 0;
+        for (Ptr<WifiMacQueue> queue : head.queues)
+            queued += queue->GetNPackets();
+
+        head.queueLength.add(queued);
+    }
+
+    if (Simulator::Now().GetSeconds() + interval <= stopTime)
+        Simulator::Schedule(Seconds(interval), &HeadMonitor::sample, this);
+}
+
+// Save heads stats and print the most loaded heads of each level
+// Heads are ranked by mean queue length, then by packets forwarded
+void HeadMonitor::report(SimulationResult &results, uint32_t top)
+{
+    std::map<uint32_t, std::vector<HeadStats *>> levels;
+
+    for (HeadStats &head : heads)
+    {
+        std::string prefix = "heads.node" + std::to_string(head.nodeId) + ".lvl" + std::to_string(head.level) + ".";
+
+        results.stats[prefix + "forwarded"] = head.forwarded;
+        results.stats[prefix + "queueMean"] = head.queueLength.mean();
+        results.stats[prefix + "queueMax"] = head.queueLength.max;
+        results.stats[prefix + "sojournMeanUs"] = head.sojourn.mean();
+        results.stats[prefix + "sojournP95Us"] = head.sojourn.quantile(0.95);
+
+        levels[head.level].push_back(&head);
+    }
+
+    for (std::pair<const uint32_t, std::vector<HeadStats *>> &level : levels)
+    {
+        std::vector<HeadStats *> &ranking = level.second;
+        std::sort(ranking.begin(), ranking.end(), [](HeadStats *a, HeadStats *b) {
+            if (a->queueLength.mean() != b->queueLength.mean())
+                return a->queueLength.mean() > b->queueLength.mean();
+            return a->forwarded > b->forwarded;
+        });
+
+        std::cout << "[Lvl " << level.first << "] Most loaded heads:" << std::endl;
+        for (uint32_t k = 0; k < std::min<size_t>(top, ranking.size()); k++)
+        {
+            HeadStats *head = ranking[k];
+            std::string prefix = "heads.lvl" + std::to_string(level.first) + ".rank" + std::to_string(k + 1) + ".";
+
+            results.stats[prefix + "node"] = head->nodeId;
+            results.stats[prefix + "queueMean"] = head->queueLength.mean();
+            results.stats[prefix + "forwarded"] = head->forwarded;
+
+            std::cout << "  Node " << head->nodeId
+                      << ": queue " << head->queueLength.mean() << " (max " << head->queueLength.max << ")"
+                      << ", sojourn p95 " << head->sojourn.quantile(0.95) << " us"
+                      << ", forwarded " << head->forwarded << std::endl;
+        }
+    }
+}
+
+// Trace sink with a rotation candidate bound
+void RotationForward(HeadRotation::Candidate *candidate, const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+{
+    candidate->forwardedBytes += packet->GetSize();
+}
+
+// Device of a node among devices (NULL if it has none)
+Ptr<WifiNetDevice> DeviceOfNode(NetDeviceContainer devices, Ptr<Node> node, bool ap)
+{
+    for (uint32_t d = 0; d < devices.GetN(); d++)
+    {
+        Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice>(devices.Get(d));
+        if (device && device->GetNode() == node && (DynamicCast<ApWifiMac>(device->GetMac()) != NULL) == ap)
+            return device;
+    }
+
+    return NULL;
+}
+
+// Find candidates devices, put standby ones to sleep and start electing
+void HeadRotation::install(Level &first, Level &second, double _interval, double _hysteresis, double _stopTime)
+{
+    interval = _interval;
+    hysteresis = _hysteresis;
+    stopTime = _stopTime;
+
+    for (Cluster &cluster : first.clusters)
+    {
+        if (cluster.headCandidates.GetN() < 2)
+            continue;
+
+        clusters.push_back(ClusterState());
+        ClusterState &state = clusters.back();
+        state.index = cluster.index;
+        state.nodes = cluster.ns3Nodes;
+        state.anchor = cluster.headCandidates.Get(0)->GetObject<MobilityModel>();
+
+        NetDeviceContainer uplinks = second.clusters[cluster.parent].ns3Devices;
+        for (uint32_t c = 0; c < cluster.headCandidates.GetN(); c++)
+        {
+            Candidate candidate;
+            candidate.node = cluster.headCandidates.Get(c);
+            candidate.ap = DeviceOfNode(cluster.ns3Devices, candidate.node, true);
+            candidate.station = DeviceOfNode(cluster.ns3Devices, candidate.node, false);
+            candidate.uplink = DeviceOfNode(uplinks, candidate.node, false);
+            candidate.resources = cluster.nodes[c].getResources();
+
+            state.candidates.push_back(candidate);
+        }
+
+        // Head doesn't need its station, the others don't need their head devices yet
+        // (sleep happens once devices are initialized)
+        for (uint32_t c = 0; c < state.candidates.size(); c++)
+        {
+            Candidate &candidate = state.candidates[c];
+
+            candidate.node->GetObject<Ipv4L3Protocol>()->TraceConnectWithoutContext(
+                "UnicastForward", MakeBoundCallback(&RotationForward, &candidate));
+
+            if (c == 0)
+                Simulator::Schedule(Seconds(0), &WifiPhy::SetSleepMode, candidate.station->GetPhy());
+            else
+            {
+                Simulator::Schedule(Seconds(0), &WifiPhy::SetSleepMode, candidate.ap->GetPhy());
+                Simulator::Schedule(Seconds(0), &WifiPhy::SetSleepMode, candidate.uplink->GetPhy());
+            }
+        }
+
+        headSince[state.candidates[0].node->GetId()] = Seconds(0);
+    }
+
+    Simulator::Schedule(Seconds(interval), &HeadRotation::elect, this);
+}
+
+// Score candidates and hand over where a better one is found
+void HeadRotation::elect()
+{
+    for (ClusterState &state : clusters)
+    {
+        std::vector<double> scores;
+
+        for (uint32_t c = 0; c < state.candidates.size(); c++)
+        {
+            Candidate &candidate = state.candidates[c];
+            candidate.load = 0.5 * candidate.load + 0.5 * candidate.forwardedBytes * 8 / interval;
+            candidate.forwardedBytes = 0;
+
+            // Only the head has frames waiting on its AP
+            double queueFill = 0;
+            if (c == state.head)
+            {
+                for (Ptr<WifiMacQueue> queue : DeviceQueues(candidate.ap))
+                    queueFill = std::max(queueFill, queue->GetNPackets() / (double)queue->GetMaxSize().GetValue());
+            }
+
+            scores.push_back(candidate.resources / (1 + candidate.load / candidate.resources + queueFill));
+        }
+
+        uint32_t best = std::max_element(scores.begin(), scores.end()) - scores.begin();
+        if (best != state.head && scores[best] > scores[state.head] * (1 + hysteresis))
+            handOver(state, best);
+    }
+
+    if (Simulator::Now().GetSeconds() + interval < stopTime)
+        Simulator::Schedule(Seconds(interval), &HeadRotation::elect, this);
+}
+
+// Move head role of a cluster to a candidate
+void HeadRotation::handOver(ClusterState &state, uint32_t next)
+{
+    Candidate &oldHead = state.candidates[state.head];
+    Candidate &newHead = state.candidates[next];
+
+    // Old head goes back to being a station, stations find the new AP once they miss
+    // enough beacons of the old one
+    oldHead.ap->GetPhy()->SetSleepMode();
+    oldHead.uplink->GetPhy()->SetSleepMode();
+    oldHead.station->GetPhy()->ResumeFromSleep();
+
+    newHead.station->GetPhy()->SetSleepMode();
+    newHead.ap->GetPhy()->ResumeFromSleep();
+    newHead.uplink->GetPhy()->ResumeFromSleep();
+
+    // Members move around the new head, which follows the anchor (the first head keeps
+    // its own model, so nobody ends up following itself)
+    Ptr<MobilityModel> newHeadMobility = newHead.node->GetObject<MobilityModel>();
+    for (uint32_t n = 0; n < state.nodes.GetN(); n++)
+    {
+        Ptr<HierarchicalMobilityModel> mobility = state.nodes.Get(n)->GetObject<HierarchicalMobilityModel>();
+        if (!mobility)
+            continue;
+
+        bool toAnchor = state.nodes.Get(n) == newHead.node || newHeadMobility == state.anchor;
+        mobility->SetParent(toAnchor ? state.anchor : newHeadMobility);
+    }
+
+    Time now = Simulator::Now();
+    headTime[oldHead.node->GetId()] += now - headSince[oldHead.node->GetId()];
+    headSince[newHead.node->GetId()] = now;
+
+    state.head = next;
+    nHandovers++;
+}
+
+// Save handovers and time each candidate was head
+void HeadRotation::report(SimulationResult &results)
+{
+    Time now = Simulator::Now();
+
+    for (ClusterState &state : clusters)
+    {
+        Candidate &head = state.candidates[state.head];
+        headTime[head.node->GetId()] += now - headSince[head.node->GetId()];
+        headSince[head.node->GetId()] = now;
+
+        for (Candidate &candidate : state.candidates)
+            results.stats["rotation.node" + std::to_string(candidate.node->GetId()) + ".headTime"] =
+                headTime[candidate.node->GetId()].GetSeconds();
+    }
+
+    results.stats["rotation.handovers"] = nHandovers;
+}
+
+// Trace sinks with level counters bound
+void TimeSeriesMacTx(TimeSeriesCollector::LevelCounters *counters, Ptr<const Packet> packet)
+{
+    counters->txPackets++;
+}
+
+void TimeSeriesMacRx(TimeSeriesCollector::LevelCounters *counters, Ptr<const Packet> packet)
+{
+    counters->rxPackets++;
+}
+
+void TimeSeriesMacDrop(TimeSeriesCollector::LevelCounters *counters, Ptr<const Packet> packet)
+{
+    counters->drops++;
+}
+
+void TimeSeriesFinalFailure(TimeSeriesCollector::LevelCounters *counters, Mac48Address address)
+{
+    counters->drops++;
+}
+
+// TX periods are reported as they start and other busy periods once they end, both whole,
+// so a long period is counted on the sample where it starts (TX) or after it ends
+void TimeSeriesPhyState(TimeSeriesCollector::LevelCounters *counters, Time start, Time duration, WifiPhyState state)
+{
+    if (state != WifiPhyState::IDLE && state != WifiPhyState::SLEEP && state != WifiPhyState::OFF)
+        counters->busy += duration;
+}
+
+// Open CSV and start writer thread
+TimeSeriesCollector::TimeSeriesCollector(std::string path, double _interval, size_t capacity)
+    : interval(_interval),
+      ring(std::max<size_t>(2, capacity))
+{
+    file = fopen(path.c_str(), "w");
+    NS_ABORT_MSG_IF(!file, "Couldn't open " << path);
+    fputs("time,level,throughput,lossRate,queueDepth,busyFraction\n", file);
+
+    writer = std::thread(&TimeSeriesCollector::writeSamples, this);
+}
+
+// Write what is left
+TimeSeriesCollector::~TimeSeriesCollector()
+{
+    finish();
+}
+
+// Connect to devices of every level and schedule first sample
+void TimeSeriesCollector::install(std::vector<Level *> hierarchy, Taller1Experiment *_parent)
+{
+    parent = _parent;
+    levels.resize(hierarchy.size() + 1);
+
+    for (size_t l = 0; l < hierarchy.size(); l++)
+    {
+        LevelCounters &counters = levels[l + 1];
+
+        for (Cluster &cluster : hierarchy[l]->clusters)
+        {
+            for (uint32_t d = 0; d < cluster.ns3Devices.GetN(); d++)
+            {
+                Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice>(cluster.ns3Devices.Get(d));
+                if (!device)
+                    continue;
+
+                counters.devices.push_back(device);
+
+                device->GetMac()->TraceConnectWithoutContext("MacTx", MakeBoundCallback(&TimeSeriesMacTx, &counters));
+                device->GetMac()->TraceConnectWithoutContext("MacRx", MakeBoundCallback(&TimeSeriesMacRx, &counters));
+                device->GetMac()->TraceConnectWithoutContext("MacTxDrop", MakeBoundCallback(&TimeSeriesMacDrop, &counters));
+                device->GetRemoteStationManager()->TraceConnectWithoutContext(
+                    "MacTxFinalDataFailed", MakeBoundCallback(&TimeSeriesFinalFailure, &counters));
+                device->GetPhy()->GetState()->TraceConnectWithoutContext(
+                    "State", MakeBoundCallback(&TimeSeriesPhyState, &counters));
+            }
+        }
+    }
+
+    Simulator::Schedule(Seconds(interval), &TimeSeriesCollector::sample, this);
+}
+
+// Take a sample of every level and schedule next one
+void TimeSeriesCollector::sample()
+{
+    double now = Simulator::Now().GetSeconds();
+
+    // End to end data
+    int sent = parent->sentCount - lastSent, received = parent->receivedCount - lastReceived;
+    push({now, 0, received / interval, sent > 0 ? std::max(0, sent - received) / (double)sent : 0, 0, 0});
+    lastSent = parent->sentCount;
+    lastReceived = parent->receivedCount;
+
+    for (uint32_t l = 1; l < levels.size(); l++)
+    {
+        LevelCounters &counters = levels[l];
+        if (counters.devices.empty())
+            continue;
+
+        // Packets waiting on MAC queues right now
+        uint32_t queued = 0;
+        for (Ptr<WifiNetDevice> device : counters.devices)
+            for (Ptr<WifiMacQueue> queue : DeviceQueues(device))
+                queued += queue->GetNPackets();
+
+        uint64_t tx = counters.txPackets - counters.lastTx, drops = counters.drops - counters.lastDrops;
+        double busy = (counters.busy - counters.lastBusy).GetSeconds();
+
+        push({now, l, (counters.rxPackets - counters.lastRx) / interval, tx > 0 ? std::min(1.0, drops / (double)tx) : 0,
+              queued / (double)counters.devices.size(), std::min(1.0, busy / (interval * counters.devices.size()))});
+
+        counters.lastTx = counters.txPackets;
+        counters.lastRx = counters.rxPackets;
+        counters.lastDrops = counters.drops;
+        counters.lastBusy = counters.busy;
+    }
+
+    if (now + interval <= parent->simulationTime)
+        Simulator::Schedule(Seconds(interval), &TimeSeriesCollector::sample, this);
+}
+
+// Add sample to ring buffer
+void TimeSeriesCollector::push(const Sample &sample)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    hasSpace.wait(lock, [this] { return written - flushed < ring.size(); });
+    ring[written++ % ring.size()] = sample;
+
+    // Writer is woken once there is a good block
+    if (written - flushed >= ring.size() / 2)
+        hasSamples.notify_one();
+}
+
+// Writer thread
+void TimeSeriesCollector::writeSamples()
+{
+    std::string block;
+    char line[160];
+
+    while (true)
+    {
+        uint64_t from, to;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            hasSamples.wait(lock, [this] { return done || written - flushed >= ring.size() / 2; });
+
+            if (done && written == flushed)
+                break;
+
+            from = flushed;
+            to = written;
+        }
+
+        // Samples in [from, to) aren't touched by the simulation until flushed moves
+        block.clear();
+        for (uint64_t i = from; i < to; i++)
+        {
+            const Sample &s = ring[i % ring.size()];
+            snprintf(line, sizeof(line), "%.6f,%u,%.6g,%.6g,%.6g,%.6g\n",
+                     s.time, s.level, s.throughput, s.lossRate, s.queueDepth, s.busyFraction);
+            block += line;
+        }
+        fwrite(block.data(), 1, block.size(), file);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            flushed = to;
+        }
+        hasSpace.notify_one();
+    }
+}
+
+// Wait until every sample is written
+void TimeSeriesCollector::finish()
+{
+    if (!writer.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    hasSamples.notify_one();
+
+    writer.join();
+    fclose(file);
+}
+
+// Start checking (nothing is done without targets)
+void EarlyStopMonitor::start(Taller1Experiment *_parent)
+{
+    parent = _parent;
+
+    if (parent->lossTarget < 0 && parent->throughputTarget <= 0)
+        return;
+
+    NS_ABORT_MSG_IF(parent->earlyStopInterval <= 0, "Early stop needs a positive interval");
+
+    // One sided quantile
+    z = NormalQuantile(parent->earlyStopConfidence);
+
+    Simulator::Schedule(Seconds(parent->earlyStopInterval), &EarlyStopMonitor::check, this);
+}
+
+// Evaluate targets and stop or schedule next check
+void EarlyStopMonitor::check()
+{
+    double now = Simulator::Now().GetSeconds();
+
+    // Both taken at once, so every packet received is among those sent
+    double sent = parent->sentCount;
+    double received = parent->receivedCount;
+    bool missed = false, met = true;
+    sentByCheck.push_back(sent);
+
+    // Flows start in an off period and routes take a while to converge
+    bool warm = sent >= parent->earlyStopMinPackets;
+
+    if (parent->lossTarget >= 0)
+    {
+        // Packets sent before the check SETTLE_CHECKS ago, and those of them received
+        int settled = (int)sentByCheck.size() - 1 - SETTLE_CHECKS;
+        double n = settled >= 0 ? sentByCheck[settled] : 0;
+        double arrived = 0;
+        for (int i = 0; i <= settled && i < (int)parent->receivedBySendInterval.size(); i++)
+            arrived += parent->receivedBySendInterval[i];
+
+        if (n < std::max(parent->earlyStopMinPackets, 1))
+            met = false;
+        else
+        {
+            double loss = std::min(1.0, std::max(0.0, 1 - arrived / n));
+            double z2 = z * z;
+            double center = (loss + z2 / (2 * n)) / (1 + z2 / n);
+            double halfWidth = z * std::sqrt(loss * (1 - loss) / n + z2 / (4 * n * n)) / (1 + z2 / n);
+
+            missed |= center - halfWidth > parent->lossTarget;
+            met &= center + halfWidth < parent->lossTarget;
+        }
+    }
+
+    if (parent->throughputTarget > 0)
+    {
+        // Already enough even if nothing else arrives
+        bool sure = received / parent->simulationTime >= parent->throughputTarget;
+
+        // At best everything sent arrives, and sending goes on at its upper bound
+        double sendRate = (sent + z * std::sqrt(sent) + z * z) / now;
+        double upper = (sent + sendRate * (parent->simulationTime - now)) / parent->simulationTime;
+
+        missed |= warm && !sure && upper < parent->throughputTarget;
+        met &= sure;
+    }
+
+    if (missed || met)
+    {
+        outcome = missed ? 0 : 1;
+        stopTime = now;
+        Simulator::Stop();
+    }
+    else if (now + parent->earlyStopInterval < parent->simulationTime)
+        Simulator::Schedule(Seconds(parent->earlyStopInterval), &EarlyStopMonitor::check, this);
+}
+
+// Connect to IPv4 of every node running OLSR
+void OlsrOverheadTracker::install(std::vector<Level *> hierarchy)
+{
+    levels.resize(hierarchy.size());
+
+    for (uint32_t l = 0; l < hierarchy.size(); l++)
+    {
+        for (Cluster &cluster : hierarchy[l]->clusters)
+        {
+            for (uint32_t d = 0; d < cluster.ns3Devices.GetN(); d++)
+            {
+                Ptr<Node> node = cluster.ns3Devices.Get(d)->GetNode();
+                Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+                if (!FindRoutingProtocol<olsr::RoutingProtocol>(ipv4))
+                    continue;
+
+                int32_t interface = ipv4->GetInterfaceForDevice(cluster.ns3Devices.Get(d));
+                if (interface >= 0)
+                    interfaceLevels[std::make_pair(node->GetId(), interface)] = l;
+
+                // Make sure every node shows up, even if it never sends anything
+                // (heads show up on several levels, but have a single IPv4)
+                if (nodes.count(node->GetId()))
+                    continue;
+                nodes[node->GetId()];
+
+                node->GetObject<Ipv4L3Protocol>()->TraceConnectWithoutContext("Tx", MakeBoundCallback(&OlsrOverheadTx, this));
+                node->GetObject<Ipv4L3Protocol>()->TraceConnectWithoutContext("Rx", MakeBoundCallback(&OlsrOverheadRx, this));
+            }
+        }
+    }
+}
+
+// Trace sink, counts packet if it's OLSR (packets carry their IPv4 header here)
+void OlsrOverheadTracker::onPacket(bool tx, Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface)
+{
+    Ipv4Header ipHeader;
+    UdpHeader udpHeader;
+    Ptr<Packet> copy = packet->Copy();
+    if (!copy->RemoveHeader(ipHeader) || ipHeader.GetProtocol() != UdpL4Protocol::PROT_NUMBER ||
+        !copy->RemoveHeader(udpHeader) || udpHeader.GetDestinationPort() != port)
+        return;
+
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t>::iterator level =
+        interfaceLevels.find(std::make_pair(ipv4->GetObject<Node>()->GetId(), interface));
+    if (level == interfaceLevels.end())
+        return;
+
+    olsr::PacketHeader header;
+    copy->RemoveHeader(header);
+
+    // Same counts go to the node and to the level of the interface
+    for (Counters *counters : {&nodes[level->first.first], &levels[level->second]})
+    {
+        (tx ? counters->txPackets : counters->rxPackets)++;
+        (tx ? counters->txPacketBytes : counters->rxPacketBytes) += header.GetPacketLength();
+    }
+
+    // Messages, as OLSR itself reads them
+    uint32_t sizeLeft = header.GetPacketLength() - header.GetSerializedSize();
+    while (sizeLeft > 0)
+    {
+        olsr::MessageHeader message;
+        if (copy->RemoveHeader(message) == 0)
+            break;
+        sizeLeft -= std::min(sizeLeft, message.GetSerializedSize());
+
+        int kind = message.GetMessageType() - 1;
+        if (kind < 0 || kind >= nKinds)
+            continue;
+
+        for (Counters *counters : {&nodes[level->first.first], &levels[level->second]})
+        {
+            (tx ? counters->txMessages : counters->rxMessages)[kind]++;
+            (tx ? counters->txBytes : counters->rxBytes)[kind] += message.GetSerializedSize();
+        }
+    }
+}
+
+// Save per level and per node counters on results
+void OlsrOverheadTracker::exportTo(SimulationResult &results, double seconds)
+{
+    const char *kindNames[nKinds] = {"hello", "tc", "mid", "hna"};
+
+    for (uint32_t l = 0; l < levels.size(); l++)
+    {
+        Counters &counters = levels[l];
+        std::string prefix = "olsr.lvl" + std::to_string(l + 1) + ".";
+
+        for (int k = 0; k < nKinds; k++)
+        {
+            results.stats[prefix + kindNames[k] + ".txMessages"] = counters.txMessages[k];
+            results.stats[prefix + kindNames[k] + ".txBytes"] = counters.txBytes[k];
+            results.stats[prefix + kindNames[k] + ".rxMessages"] = counters.rxMessages[k];
+            results.stats[prefix + kindNames[k] + ".rxBytes"] = counters.rxBytes[k];
+        }
+
+        results.stats[prefix + "txPackets"] = counters.txPackets;
+        results.stats[prefix + "rxPackets"] = counters.rxPackets;
+        results.stats[prefix + "txBytesPerSecond"] = counters.txPacketBytes / seconds;
+        results.stats[prefix + "rxBytesPerSecond"] = counters.rxPacketBytes / seconds;
+    }
+
+    for (std::pair<const uint32_t, Counters> &node : nodes)
+    {
+        std::string prefix = "olsr.node" + std::to_string(node.first) + ".";
+
+        results.stats[prefix + "txBytes"] = node.second.txPacketBytes;
+        results.stats[prefix + "rxBytes"] = node.second.rxPacketBytes;
+    }
+}
+
+// Generate flows over first level nodes
+void TrafficMatrix::generate(
+    std::string model, int nFlows, Level &level, double intraClusterFraction, double hotspotFraction, uint32_t seed)
+{
+    NS_ABORT_MSG_IF(model != "uniform" && model != "gravity" && model != "hotspot", "Unknown traffic model " << model);
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> coin(0, 1);
+
+    // Flatten nodes, so they can be picked with a single index
+    std::vector<std::pair<uint32_t, uint32_t>> allNodes;
+    std::vector<double> weights;
+    for (uint32_t c = 0; c < level.clusters.size(); c++)
+    {
+        for (uint32_t n = 0; n < level.clusters[c].nodes.size(); n++)
+        {
+            allNodes.push_back(std::make_pair(c, n));
+            weights.push_back(model == "gravity" ? level.clusters[c].nodes[n].getResources() : 1.0);
+        }
+    }
+
+    NS_ABORT_MSG_IF(allNodes.size() < 2, "Traffic needs at least two nodes");
+
+    std::discrete_distribution<uint32_t> pick(weights.begin(), weights.end());
+
+    flows.reserve(flows.size() + nFlows);
+    for (int i = 0; i < nFlows; i++)
+    {
+        std::pair<uint32_t, uint32_t> src = allNodes[pick(rng)];
+        std::pair<uint32_t, uint32_t> dst;
+        uint32_t clusterSize = level.clusters[src.first].nodes.size();
+
+        // A lone head has no other head to send to
+        bool canHotspot = model == "hotspot" && (level.clusters.size() > 1 || src.second != 0);
+
+        if (intraClusterFraction >= 0 && clusterSize > 1)
+        {
+            bool intra = coin(rng) < intraClusterFraction;
+
+            do
+            {
+                if (intra)
+                    dst = std::make_pair(src.first, (uint32_t)(rng() % clusterSize));
+                else if (canHotspot && coin(rng) < hotspotFraction)
+                    dst = std::make_pair((uint32_t)(rng() % level.clusters.size()), 0u);
+                else
+                    dst = allNodes[pick(rng)];
+            } while (dst == src || (!intra && dst.first == src.first && level.clusters.size() > 1));
+        }
+        else
+        {
+            do
+            {
+                if (canHotspot && coin(rng) < hotspotFraction)
+                    dst = std::make_pair((uint32_t)(rng() % level.clusters.size()), 0u);
+                else
+                    dst = allNodes[pick(rng)];
+            } while (dst == src);
+        }
+
+        flows.push_back({src.first, src.second, dst.first, dst.second});
+    }
+}
+
+// Load flows from a CSV
+void TrafficMatrix::load(std::string path, Level &level)
+{
+    std::ifstream file(path);
+    NS_ABORT_MSG_IF(!file.is_open(), "Couldn't open traffic file " << path);
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+
+        // Skip comments and empty lines
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        TrafficFlow flow;
+        char comma;
+        std::stringstream ss(line);
+
+        if (!(ss >> flow.srcCluster >> comma >> flow.srcNode >> comma >> flow.dstCluster >> comma >> flow.dstNode))
+        {
+            // A header is allowed on first line
+            NS_ABORT_MSG_IF(lineNumber > 1, "Bad flow at " << path << ":" << lineNumber);
+            continue;
+        }
+
+        NS_ABORT_MSG_IF(flow.srcCluster >= level.clusters.size() || flow.dstCluster >= level.clusters.size() ||
+                            flow.srcNode >= level.clusters[flow.srcCluster].nodes.size() ||
+                            flow.dstNode >= level.clusters[flow.dstCluster].nodes.size(),
+                        "Flow out of range at " << path << ":" << lineNumber);
+
+        flows.push_back(flow);
+    }
+}
+
+// Group flows by sender in O(flows + nodes), keeping their relative order
+void TrafficMatrix::sortBySender(Level &level)
+{
+    // First node index of each cluster
+    std::vector<uint32_t> firstNode(level.clusters.size() + 1, 0);
+    for (uint32_t c = 0; c < level.clusters.size(); c++)
+        firstNode[c + 1] = firstNode[c] + level.clusters[c].nodes.size();
+
+    // Counting sort
+    std::vector<uint32_t> start(firstNode.back() + 1, 0);
+    for (TrafficFlow &flow : flows)
+        start[firstNode[flow.srcCluster] + flow.srcNode + 1]++;
+
+    for (uint32_t i = 1; i < start.size(); i++)
+        start[i] += start[i - 1];
+
+    std::vector<TrafficFlow> sorted(flows.size());
+    for (TrafficFlow &flow : flows)
+        sorted[start[firstNode[flow.srcCluster] + flow.srcNode]++] = flow;
+
+    flows.swap(sorted);
+}
+
+// Open trace (format is detected from its first bytes)
+TraceReplay::TraceReplay(std::string path, uint32_t _readAhead, Level &level, Taller1Experiment *_parent)
+    : file(path, std::ios::binary),
+      readAhead(std::max<uint32_t>(1, _readAhead)),
+      parent(_parent)
+{
+    NS_ABORT_MSG_IF(!file.is_open(), "Couldn't open trace " << path);
+
+    for (Cluster &cluster : level.clusters)
+    {
+        for (ClusterNode &node : cluster.nodes)
+            endpoints.push_back(&node);
+    }
+
+    // Pcap files start with a magic number, anything else is taken as CSV
+    uint8_t header[24];
+    file.read((char *)header, sizeof(header));
+
+    uint32_t magic = header[0] | header[1] << 8 | header[2] << 16 | (uint32_t)header[3] << 24;
+    if (file.gcount() == sizeof(header) &&
+        (magic == 0xa1b2c3d4 || magic == 0xd4c3b2a1 || magic == 0xa1b23c4d || magic == 0x4d3cb2a1))
+    {
+        isPcap = true;
+        swapped = magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+        nanoseconds = magic == 0xa1b23c4d || magic == 0x4d3cb2a1;
+
+        linkType = swapped ? (uint32_t)header[20] << 24 | header[21] << 16 | header[22] << 8 | header[23]
+                           : header[20] | header[21] << 8 | header[22] << 16 | (uint32_t)header[23] << 24;
+
+        NS_ABORT_MSG_IF(linkType != 1 && linkType != 101 && linkType != 113,
+                        "Unsupported pcap link type " << linkType);
+    }
+    else
+    {
+        file.clear();
+        file.seekg(0);
+    }
+}
+
+// Schedule first packet
+void TraceReplay::start()
+{
+    refill();
+
+    if (!buffer.empty())
+        Simulator::Schedule(NanoSeconds(buffer.front().time - firstTime), &TraceReplay::sendNext, this);
+}
+
+// Fill buffer up to readAhead records
+void TraceReplay::refill()
+{
+    TracePacket packet;
+
+    while (!finished && buffer.size() < readAhead)
+    {
+        if (!(isPcap ? readPcapRecord(packet) : readCsvRecord(packet)))
+        {
+            finished = true;
+            break;
+        }
+
+        if (firstTime < 0)
+            firstTime = packet.time;
+
+        // Nothing beyond simulation time is needed
+        if (packet.time - firstTime > Seconds(parent->simulationTime).GetNanoSeconds())
+        {
+            finished = true;
+            break;
+        }
+
+        buffer.push_back(packet);
+    }
+}
+
+// Read next CSV record (time in seconds, size in bytes, endpoints as numbers or IPv4)
+bool TraceReplay::readCsvRecord(TracePacket &packet)
+{
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::stringstream ss(line);
+        std::string time, size, src, dst;
+
+        if (!std::getline(ss, time, ',') || !std::getline(ss, size, ',') ||
+            !std::getline(ss, src, ',') || !std::getline(ss, dst, ','))
+        {
+            nSkipped++;
+            continue;
+        }
+
+        // Header or garbage
+        char *end;
+        double seconds = std::strtod(time.c_str(), &end);
+        if (end == time.c_str())
+        {
+            nSkipped++;
+            continue;
+        }
+
+        packet.time = (int64_t)(seconds * 1e9);
+        packet.size = std::atoi(size.c_str());
+        packet.src = src.find('.') != std::string::npos ? Ipv4Address(src.c_str()).Get() : std::strtoul(src.c_str(), NULL, 10);
+        packet.dst = dst.find('.') != std::string::npos ? Ipv4Address(dst.c_str()).Get() : std::strtoul(dst.c_str(), NULL, 10);
+
+        return true;
+    }
+
+    return false;
+}
+
+// Read next IPv4 packet from pcap, other protocols are skipped
+bool TraceReplay::readPcapRecord(TracePacket &packet)
+{
+    uint8_t record[16];
+    std::vector<uint8_t> data;
+
+    // Link header size
+    uint32_t offset = linkType == 1 ? 14 : linkType == 113 ? 16 : 0;
+
+    while (file.read((char *)record, sizeof(record)))
+    {
+        uint32_t fields[4];
+        for (int f = 0; f < 4; f++)
+        {
+            uint8_t *b = record + 4 * f;
+            fields[f] = swapped ? (uint32_t)b[0] << 24 | b[1] << 16 | b[2] << 8 | b[3]
+                                : b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+        }
+
+        uint32_t capturedLength = fields[2];
+        data.resize(capturedLength);
+        if (!file.read((char *)data.data(), capturedLength))
+            return false;
+
+        // Skip VLAN tags on ethernet
+        uint32_t ipOffset = offset;
+        if (linkType == 1)
+        {
+            while (capturedLength >= ipOffset + 4 && data[ipOffset - 2] == 0x81 && data[ipOffset - 1] == 0x00)
+                ipOffset += 4;
+
+            if (capturedLength < ipOffset || data[ipOffset - 2] != 0x08 || data[ipOffset - 1] != 0x00)
+            {
+                nSkipped++;
+                continue;
+            }
+        }
+
+        if (capturedLength < ipOffset + 20 || (data[ipOffset] >> 4) != 4)
+        {
+            nSkipped++;
+            continue;
+        }
+
+        uint8_t *ip = data.data() + ipOffset;
+        packet.time = (int64_t)fields[0] * 1000000000 + (int64_t)fields[1] * (nanoseconds ? 1 : 1000);
+        packet.size = ip[2] << 8 | ip[3];
+        packet.src = (uint32_t)ip[12] << 24 | ip[13] << 16 | ip[14] << 8 | ip[15];
+        packet.dst = (uint32_t)ip[16] << 24 | ip[17] << 16 | ip[18] << 8 | ip[19];
+
+        // Payload without IP and UDP headers is what gets sent
+        packet.size = packet.size > 28 ? packet.size - 28 : 1;
+
+        return true;
+    }
+
+    return false;
+}
+
+// Node an endpoint maps to (same endpoint, same node)
+ClusterNode &TraceReplay::mapEndpoint(uint32_t endpoint)
+{
+    uint64_t x = endpoint + 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+
+    return *endpoints[x % endpoints.size()];
+}
+
+// Send packet at the front and schedule the next one
+void TraceReplay::sendNext()
+{
+    TracePacket packet = buffer.front();
+    buffer.pop_front();
+
+    ClusterNode &sender = mapEndpoint(packet.src);
+    ClusterNode *receiver = &mapEndpoint(packet.dst);
+
+    // Different endpoints may land on the same node
+    if (receiver == &sender)
+        receiver = endpoints[(std::find(endpoints.begin(), endpoints.end(), receiver) - endpoints.begin() + 1) % endpoints.size()];
+
+    Ptr<Socket> &socket = sockets[sender.node->GetId()];
+    if (!socket)
+    {
+        socket = Socket::CreateSocket(sender.node, UdpSocketFactory::GetTypeId());
+        socket->Bind();
+    }
+
+    receiver->configureAsReceiver(parent);
+
+    Ipv4Address remoteAddr = receiver->node->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+    Ptr<Packet> replayed = Create<Packet>(std::min<uint32_t>(std::max<uint32_t>(packet.size, 1), 65507));
+    FlowClassTag::mark(FlowClassTag::BE, replayed);
+    socket->SendTo(replayed, 0, InetSocketAddress(remoteAddr, parent->port));
+
+    parent->sentCount++;
+    parent->flowClasses[FlowClassTag::BE].sent++;
+    nReplayed++;
+
+    // Keep buffer at least half full
+    if (buffer.size() < readAhead / 2 + 1)
+        refill();
+
+    if (!buffer.empty())
+    {
+        int64_t delay = std::max<int64_t>(0, buffer.front().time - firstTime - Simulator::Now().GetNanoSeconds());
+        Simulator::Schedule(NanoSeconds(delay), &TraceReplay::sendNext, this);
+    }
+}
+
+// Override settings from a profile string
+void PhyProfile::apply(std::string profile)
+{
+    std::stringstream ss(profile);
+    std::string pair;
+
+    while (std::getline(ss, pair, ','))
+    {
+        if (pair.empty())
+            continue;
+
+        size_t equal = pair.find('=');
+        NS_ABORT_MSG_IF(equal == std::string::npos, "Bad PHY profile setting " << pair);
+        std::string key = pair.substr(0, equal), value = pair.substr(equal + 1);
+
+        if (key == "standard")
+            standard = value;
+        else if (key == "width")
+            width = std::atoi(value.c_str());
+        else if (key == "manager")
+            manager = value;
+        else if (key == "mode")
+            mode = value;
+        else if (key == "ampdu")
+            ampdu = std::atoi(value.c_str());
+        else if (key == "amsdu")
+            amsdu = std::atoi(value.c_str());
+        else if (key == "qos")
+            qos = value == "1" || value == "true";
+        else if (key.size() > 3 && key[2] == '.' && FlowClassTag::fromName(key.substr(0, 2)) < FlowClassTag::N_CLASSES)
+            edca[key] = value;
+        else
+            NS_ABORT_MSG("Unknown PHY profile setting " << key);
+    }
+
+    NS_ABORT_MSG_IF(manager != "constant" && manager != "aarf" && manager != "minstrel" && manager != "ideal",
+                    "Unknown rate manager " << manager);
+    NS_ABORT_MSG_IF(manager == "aarf" && highThroughput(), "AARF only handles legacy rates, use minstrel or ideal");
+}
+
+// HT and later standards (QoS MAC, aggregation)
+bool PhyProfile::highThroughput() const
+{
+    return standard != "11a" && standard != "11g";
+}
+
+// MAC has a queue per access category
+bool PhyProfile::qosSupported() const
+{
+    return qos || highThroughput() || !edca.empty();
+}
+
+// Set standard and manager on helper, returns phy helper with channel width
+YansWifiPhyHelper PhyProfile::configure(WifiHelper &wifi, const YansWifiPhyHelper &phy) const
+{
+    std::map<std::string, WifiStandard> standards = {
+        {"11a", WIFI_STANDARD_80211a},
+        {"11g", WIFI_STANDARD_80211g},
+        {"11n", WIFI_STANDARD_80211n_5GHZ},
+        {"11n2.4", WIFI_STANDARD_80211n_2_4GHZ},
+        {"11ac", WIFI_STANDARD_80211ac},
+        {"11ax", WIFI_STANDARD_80211ax_5GHZ},
+        {"11ax2.4", WIFI_STANDARD_80211ax_2_4GHZ}};
+
+    NS_ABORT_MSG_IF(standards.count(standard) == 0, "Unknown standard " << standard);
+    wifi.SetStandard(standards[standard]);
+
+    if (manager == "constant")
+    {
+        // Control frames go at the lowest rate of the same family (like wifi-aggregation)
+        std::string control = mode.compare(0, 2, "He") == 0    ? "HeMcs0"
+                              : mode.compare(0, 3, "Vht") == 0 ? "VhtMcs0"
+                              : mode.compare(0, 2, "Ht") == 0  ? "HtMcs0"
+                                                               : "";
+        if (control.empty())
+            wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager", "DataMode", StringValue(mode));
+        else
+            wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
+                                         "DataMode", StringValue(mode),
+                                         "ControlMode", StringValue(control));
+    }
+    else if (manager == "aarf")
+        wifi.SetRemoteStationManager("ns3::AarfWifiManager");
+    else if (manager == "minstrel")
+        wifi.SetRemoteStationManager(highThroughput() ? "ns3::MinstrelHtWifiManager" : "ns3::MinstrelWifiManager");
+    else
+        wifi.SetRemoteStationManager("ns3::IdealWifiManager");
+
+    // Width is set on a copy, so it doesn't leak into other levels
+    YansWifiPhyHelper levelPhy = phy;
+    if (width > 0)
+        levelPhy.Set("ChannelWidth", UintegerValue(width));
+
+    return levelPhy;
+}
+
+// Set aggregation limits and EDCA parameters on installed devices
+void PhyProfile::configureMac(NetDeviceContainer devices) const
+{
+    for (uint32_t d = 0; d < devices.GetN(); d++)
+    {
+        Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice>(devices.Get(d));
+
+        // Same limits on every access category, so classes differ only in priority
+        for (std::string ac : {"BE", "BK", "VI", "VO"})
+        {
+            if (highThroughput() && ampdu > 0)
+                device->GetMac()->SetAttribute(ac + "_MaxAmpduSize", UintegerValue(ampdu));
+            if (highThroughput() && amsdu > 0)
+                device->GetMac()->SetAttribute(ac + "_MaxAmsduSize", UintegerValue(amsdu));
+        }
+
+        for (auto &setting : edca)
+        {
+            // "vi.MinCw" -> attribute MinCw of VI_Txop
+            std::string ac = setting.first.substr(0, 2);
+            std::transform(ac.begin(), ac.end(), ac.begin(), ::toupper);
+
+            PointerValue txop;
+            device->GetMac()->GetAttribute(ac + "_Txop", txop);
+            NS_ABORT_MSG_IF(!txop.Get<QosTxop>()->SetAttributeFailSafe(setting.first.substr(3), StringValue(setting.second)),
+                            "Bad EDCA setting " << setting.first << "=" << setting.second);
+        }
+    }
+}
+
+// Profile as a string, for results
+std::string PhyProfile::describe() const
+{
+    std::string profile = "standard=" + standard + ",width=" + std::to_string(width) + ",manager=" + manager +
+                          ",mode=" + mode + ",ampdu=" + std::to_string(ampdu) + ",amsdu=" + std::to_string(amsdu) +
+                          ",qos=" + std::to_string(qosSupported());
+
+    for (auto &setting : edca)
+        profile += "," + setting.first + "=" + setting.second;
+
+    return profile;
+}
+
+// Override settings from a profile string
+void BackboneProfile::apply(std::string profile)
+{
+    std::stringstream ss(profile);
+    std::string pair;
+
+    while (std::getline(ss, pair, ','))
+    {
+        if (pair.empty())
+            continue;
+
+        size_t equal = pair.find('=');
+        std::string key = equal == std::string::npos ? "medium" : pair.substr(0, equal);
+        std::string value = pair.substr(equal == std::string::npos ? 0 : equal + 1);
+
+        if (key == "medium")
+            medium = value;
+        else if (key == "rate")
+            rate = value;
+        else if (key == "delay")
+            delay = value;
+        else if (key == "qdisc")
+            qdisc = value;
+        else
+            NS_ABORT_MSG("Unknown backbone setting " << key);
+    }
+
+    NS_ABORT_MSG_IF(medium != "wifi" && medium != "csma" && medium != "p2p", "Unknown backbone medium " << medium);
+}
+
+bool BackboneProfile::wired() const
+{
+    return medium != "wifi";
+}
+
+bool BackboneProfile::pointToPoint() const
+{
+    return medium == "p2p";
+}
+
+// Connect nodes, returns devices (point to point links get addresses from helper)
+NetDeviceContainer BackboneProfile::install(NodeContainer nodes, Ipv4AddressHelper &linkAddresses) const
+{
+    NetDeviceContainer devices;
+
+    if (medium == "csma")
+    {
+        CsmaHelper csma;
+        csma.SetChannelAttribute("DataRate", StringValue(rate));
+        csma.SetChannelAttribute("Delay", StringValue(delay));
+
+        devices = csma.Install(nodes);
+    }
+    else
+    {
+        PointToPointHelper pointToPoint;
+        pointToPoint.SetDeviceAttribute("DataRate", StringValue(rate));
+        pointToPoint.SetChannelAttribute("Delay", StringValue(delay));
+
+        for (uint32_t a = 0; a < nodes.GetN(); a++)
+        {
+            for (uint32_t b = a + 1; b < nodes.GetN(); b++)
+            {
+                NetDeviceContainer link = pointToPoint.Install(nodes.Get(a), nodes.Get(b));
+                linkAddresses.Assign(link);
+                linkAddresses.NewNetwork();
+                devices.Add(link);
+            }
+        }
+    }
+
+    return devices;
+}
+
+// Replace root queue disc of devices (after addresses, which install a default one)
+void BackboneProfile::configureQueues(NetDeviceContainer devices) const
+{
+    if (!wired())
+        return;
+
+    std::map<std::string, std::string> names = {
+        {"pfifo_fast", "ns3::PfifoFastQueueDisc"},
+        {"fifo", "ns3::FifoQueueDisc"},
+        {"red", "ns3::RedQueueDisc"},
+        {"codel", "ns3::CoDelQueueDisc"},
+        {"fq_codel", "ns3::FqCoDelQueueDisc"}};
+
+    TrafficControlHelper trafficControl;
+    trafficControl.Uninstall(devices);
+
+    if (qdisc == "none")
+        return;
+
+    trafficControl.SetRootQueueDisc(names.count(qdisc) ? names[qdisc] : qdisc);
+    trafficControl.Install(devices);
+}
+
+// Profile as a string, for results
+std::string BackboneProfile::describe() const
+{
+    return wired() ? "medium=" + medium + ",rate=" + rate + ",delay=" + delay + ",qdisc=" + qdisc : "medium=wifi";
+}
+
+TokenBucket::TokenBucket(double _rate, double _depth)
+    : rate(_rate),
+      depth(_depth),
+      tokens(_depth)
+{
+}
+
+// Add tokens earned until a time
+void TokenBucket::refill(Time now)
+{
+    tokens = std::min(depth, tokens + rate * (now - last).GetSeconds());
+    last = now;
+}
+
+// Time until a packet of this size conforms (zero when it already does)
+Time TokenBucket::wait(uint32_t size) const
+{
+    // Packets larger than the bucket only need it full
+    double needed = std::min<double>(size, depth) - tokens;
+
+    return needed > 0 ? Seconds(needed / rate) : Time(0);
+}
+
+// Index of the member sending an item (members.size() for any other traffic)
+uint32_t AdmissionBudget::memberOf(Ptr<const QueueDiscItem> item)
+{
+    Ptr<const Ipv4QueueDiscItem> ipItem = DynamicCast<const Ipv4QueueDiscItem>(item);
+    if (!ipItem)
+        return members.size();
+
+    std::unordered_map<uint32_t, uint32_t>::iterator member = memberIndexes.find(ipItem->GetHeader().GetSource().Get());
+    return member == memberIndexes.end() ? members.size() : member->second;
+}
+
+NS_OBJECT_ENSURE_REGISTERED(HeadAdmissionQueueDisc);
+
+TypeId HeadAdmissionQueueDisc::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::HeadAdmissionQueueDisc")
+                            .SetParent<QueueDisc>()
+                            .SetGroupName("TrafficControl")
+                            .AddConstructor<HeadAdmissionQueueDisc>()
+                            .AddAttribute("MaxSize", "Packets held by every queue together",
+                                          QueueSizeValue(QueueSize("1000p")),
+                                          MakeQueueSizeAccessor(&QueueDisc::SetMaxSize, &QueueDisc::GetMaxSize),
+                                          MakeQueueSizeChecker());
+    return tid;
+}
+
+HeadAdmissionQueueDisc::HeadAdmissionQueueDisc()
+    : QueueDisc(QueueDiscSizePolicy::MULTIPLE_QUEUES, QueueSizeUnit::PACKETS)
+{
+}
+
+void HeadAdmissionQueueDisc::DoDispose()
+{
+    Simulator::Cancel(wakeUp);
+    QueueDisc::DoDispose();
+}
+
+// Take tokens for a member packet from both buckets, if it conforms
+bool HeadAdmissionQueueDisc::admit(TokenBucket &member, uint32_t size)
+{
+    Time now = Simulator::Now();
+    member.refill(now);
+    budget->aggregate.refill(now);
+
+    if (member.wait(size).IsStrictlyPositive() || budget->aggregate.wait(size).IsStrictlyPositive())
+        return false;
+
+    member.tokens -= size;
+    budget->aggregate.tokens -= size;
+    budget->admitted++;
+
+    return true;
+}
+
+bool HeadAdmissionQueueDisc::DoEnqueue(Ptr<QueueDiscItem> item)
+{
+    if (GetCurrentSize() + item > GetMaxSize())
+    {
+        DropBeforeEnqueue(item, LIMIT_EXCEEDED_DROP);
+        return false;
+    }
+
+    uint32_t member = budget->memberOf(item);
+    if (member == budget->members.size())
+        return GetInternalQueue(0)->Enqueue(item);
+
+    // Shaping decides on dequeue, each member waiting on its own queue
+    if (shape)
+        return GetInternalQueue(1 + member)->Enqueue(item);
+
+    // Policing decides on arrival
+    if (!admit(budget->members[member], item->GetSize()))
+    {
+        bool memberOver = budget->members[member].wait(item->GetSize()).IsStrictlyPositive();
+        (memberOver ? budget->memberDrops : budget->aggregateDrops)++;
+        DropBeforeEnqueue(item, memberOver ? MEMBER_DROP : AGGREGATE_DROP);
+        return false;
+    }
+
+    return GetInternalQueue(1)->Enqueue(item);
+}
+
+Ptr<QueueDiscItem> HeadAdmissionQueueDisc::DoDequeue()
+{
+    if (GetInternalQueue(0)->Peek())
+        return GetInternalQueue(0)->Dequeue();
+
+    // Policed packets conform already
+    if (!shape)
+        return GetInternalQueue(1)->Dequeue();
+
+    // Members in turn, from the one after the last served, skipping those whose front
+    // packet doesn't conform yet
+    uint32_t nMembers = budget->members.size();
+    Time wait = Time::Max();
+    for (uint32_t i = 0; i < nMembers; i++)
+    {
+        uint32_t member = (nextMember + i) % nMembers;
+        Ptr<const QueueDiscItem> front = GetInternalQueue(1 + member)->Peek();
+        if (!front)
+            continue;
+
+        TokenBucket &bucket = budget->members[member];
+        if (admit(bucket, front->GetSize()))
+        {
+            nextMember = (member + 1) % nMembers;
+            return GetInternalQueue(1 + member)->Dequeue();
+        }
+
+        wait = Min(wait, Max(bucket.wait(front->GetSize()), budget->aggregate.wait(front->GetSize())));
+    }
+
+    // Wake up once the first of them conforms
+    if (wait != Time::Max())
+    {
+        if (wakeUp.IsRunning() && Simulator::GetDelayLeft(wakeUp) > wait)
+            Simulator::Cancel(wakeUp);
+        if (!wakeUp.IsRunning())
+            wakeUp = Simulator::Schedule(wait, &QueueDisc::Run, this);
+    }
+
+    return NULL;
+}
+
+bool HeadAdmissionQueueDisc::CheckConfig()
+{
+    if (GetNQueueDiscClasses() > 0 || GetNPacketFilters() > 0)
+    {
+        NS_LOG_ERROR("HeadAdmissionQueueDisc has no classes nor packet filters");
+        return false;
+    }
+
+    if (!budget)
+    {
+        NS_LOG_ERROR("HeadAdmissionQueueDisc needs a budget");
+        return false;
+    }
+
+    // Unlimited traffic, then members (one queue each when shaping)
+    while (GetNInternalQueues() < (shape ? 1 + budget->members.size() : 2))
+        AddInternalQueue(CreateObjectWithAttributes<DropTailQueue<QueueDiscItem>>("MaxSize", QueueSizeValue(GetMaxSize())));
+
+    return true;
+}
+
+void HeadAdmissionQueueDisc::InitializeParams()
+{
+}
+
+// Replace root queue disc of every device of each first level head (police or shape)
+// Members get their resources as rate (with burst seconds of it as depth) and the
+// cluster the sum of them, both scaled by headroom
+std::vector<std::shared_ptr<AdmissionBudget>> HeadAdmissionQueueDisc::install(
+    Level &level, std::string mode, double burst, double headroom)
+{
+    NS_ABORT_MSG_IF(mode != "police" && mode != "shape", "Unknown admission mode " << mode);
+
+    std::vector<std::shared_ptr<AdmissionBudget>> budgets;
+
+    for (Cluster &cluster : level.clusters)
+    {
+        Ptr<Node> head = cluster.headContainer.Get(0);
+        std::shared_ptr<AdmissionBudget> budget = std::make_shared<AdmissionBudget>();
+        double clusterRate = 0;
+
+        for (ClusterNode &member : cluster.nodes)
+        {
+            if (member.node == head)
+                continue;
+
+            // Resources are bit/s, buckets work in bytes (at least two packets deep)
+            double rate = member.getResources() * headroom / 8;
+            Ipv4Address address = member.node->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+            budget->memberIndexes[address.Get()] = budget->members.size();
+            budget->members.push_back(TokenBucket(rate, std::max(rate * burst, 3000.0)));
+            clusterRate += rate;
+        }
+
+        budget->aggregate = TokenBucket(clusterRate, std::max(clusterRate * burst, 3000.0));
+        budgets.push_back(budget);
+
+        Ptr<TrafficControlLayer> trafficControl = head->GetObject<TrafficControlLayer>();
+        for (uint32_t d = 0; d < head->GetNDevices(); d++)
+        {
+            Ptr<NetDevice> device = head->GetDevice(d);
+            if (DynamicCast<LoopbackNetDevice>(device))
+                continue;
+
+            Ptr<HeadAdmissionQueueDisc> queueDisc = CreateObject<HeadAdmissionQueueDisc>();
+            queueDisc->budget = budget;
+            queueDisc->shape = mode == "shape";
+
+            if (trafficControl->GetRootQueueDiscOnDevice(device))
+                trafficControl->DeleteRootQueueDiscOnDevice(device);
+            trafficControl->SetRootQueueDisc(device, queueDisc);
+        }
+    }
+
+    return budgets;
+}
+
+// Channel of each cluster, by method
+std::vector<uint32_t> ChannelPlanner::plan(const std::vector<Vector> &heads, double range, uint32_t nChannels, std::string method)
+{
+    NS_ABORT_MSG_IF(method != "dsatur" && method != "greedy" && method != "roundRobin", "Unknown channel plan " << method);
+    NS_ABORT_MSG_IF(nChannels == 0, "At least one channel is needed");
+
+    uint32_t n = heads.size();
+    std::vector<uint32_t> channels(n, UINT32_MAX);
+
+    if (method == "roundRobin")
+    {
+        for (uint32_t i = 0; i < n; i++)
+            channels[i] = i % nChannels;
+        return channels;
+    }
+
+    // Interference graph
+    std::vector<std::vector<uint32_t>> neighbours(n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        for (uint32_t j = i + 1; j < n; j++)
+        {
+            if (CalculateDistance(heads[i], heads[j]) < range)
+            {
+                neighbours[i].push_back(j);
+                neighbours[j].push_back(i);
+            }
+        }
+    }
+
+    // Colour a cluster, closer neighbours weigh more when channels must be reused
+    auto assign = [&](uint32_t i) {
+        std::vector<double> cost(nChannels, 0);
+        for (uint32_t j : neighbours[i])
+        {
+            if (channels[j] != UINT32_MAX)
+                cost[channels[j]] += 1 + range / std::max(1.0, CalculateDistance(heads[i], heads[j]));
+        }
+
+        channels[i] = std::min_element(cost.begin(), cost.end()) - cost.begin();
+    };
+
+    if (method == "greedy")
+    {
+        std::vector<uint32_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return neighbours[a].size() > neighbours[b].size();
+        });
+
+        for (uint32_t i : order)
+            assign(i);
+    }
+    else
+    {
+        for (uint32_t step = 0; step < n; step++)
+        {
+            // Most distinct channels around, then most neighbours
+            uint32_t best = UINT32_MAX;
+            size_t bestSaturation = 0;
+
+            for (uint32_t i = 0; i < n; i++)
+            {
+                if (channels[i] != UINT32_MAX)
+                    continue;
+
+                std::set<uint32_t> around;
+                for (uint32_t j : neighbours[i])
+                {
+                    if (channels[j] != UINT32_MAX)
+                        around.insert(channels[j]);
+                }
+
+                if (best == UINT32_MAX || around.size() > bestSaturation ||
+                    (around.size() == bestSaturation && neighbours[i].size() > neighbours[best].size()))
+                {
+                    best = i;
+                    bestSaturation = around.size();
+                }
+            }
+
+            assign(best);
+        }
+    }
+
+    return channels;
+}
+
+// Pairs of neighbours sharing a channel
+uint32_t ChannelPlanner::conflicts(const std::vector<Vector> &heads, double range, const std::vector<uint32_t> &channels)
+{
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < heads.size(); i++)
+    {
+        for (uint32_t j = i + 1; j < heads.size(); j++)
+        {
+            if (channels[i] == channels[j] && CalculateDistance(heads[i], heads[j]) < range)
+                count++;
+        }
+    }
+
+    return count;
+}
+
+// Bits needed to number n different values
+int BitsFor(int n)
+{
+    int nBits = 0;
+
+    while ((1 << nBits) < n)
+        nBits++;
+
+    return nBits;
+}
+
+// Calculate bits needed by each level
+void HierarchicalAddressAllocator::configure(std::vector<int> _fanOuts, std::vector<int> _devices)
+{
+    fanOuts = _fanOuts;
+    devices = _devices;
+    bits.clear();
+
+    // First level numbers hosts, which can't use network nor broadcast addresses
+    bits.push_back(BitsFor(devices[0] + 2));
+
+    int totalBits = bits[0];
+    for (uint32_t l = 1; l < fanOuts.size(); l++)
+    {
+        bits.push_back(BitsFor(fanOuts[l]));
+        totalBits += bits[l];
+    }
+
+    NS_ABORT_MSG_IF(totalBits > 24, "Hierarchy needs " << totalBits << " address bits, only 24 are available");
+}
+
+// Prefix covering the whole subtree of a cluster
+std::pair<Ipv4Address, Ipv4Mask> HierarchicalAddressAllocator::subtreePrefix(int level, int clusterIndex)
+{
+    // Bits below this level are free for the subtree
+    int offset = 0;
+    for (int l = 0; l <= level; l++)
+        offset += bits[l];
+
+    // Walk up the tree, each level adds the position of the cluster within its parent
+    uint32_t value = 0;
+    int index = clusterIndex;
+    for (uint32_t l = level + 1; l < fanOuts.size(); l++)
+    {
+        value |= (uint32_t)(index % fanOuts[l]) << offset;
+        offset += bits[l];
+        index /= fanOuts[l];
+    }
+
+    uint32_t prefixLength = 32 - std::accumulate(bits.begin(), bits.begin() + level + 1, 0);
+    Ipv4Mask mask(prefixLength == 0 ? 0 : 0xffffffff << (32 - prefixLength));
+
+    return std::make_pair(Ipv4Address(Ipv4Address("10.0.0.0").Get() | value), mask);
+}
+
+// Network for the devices of a cluster
+std::pair<Ipv4Address, Ipv4Mask> HierarchicalAddressAllocator::clusterNetwork(int level, int clusterIndex)
+{
+    // First level devices take the whole subtree
+    if (level == 0)
+        return subtreePrefix(0, clusterIndex);
+
+    // Upper levels get a /14 block each (172.16.0.0/14 to 172.24.0.0/14), split in networks
+    // as big as the fan-out needs
+    int hostBits = BitsFor(devices[level] + 2);
+    NS_ABORT_MSG_IF(((uint64_t)clusterIndex << hostBits) >= (1 << 18), "Too many clusters on level " << level + 1);
+
+    uint32_t value = Ipv4Address("172.16.0.0").Get() | ((uint32_t)(level - 1) << 18) | ((uint32_t)clusterIndex << hostBits);
+
+    return std::make_pair(Ipv4Address(value), Ipv4Mask(0xffffffff << hostBits));
+}
+
+// Set helper base to the network of a cluster
+void HierarchicalAddressAllocator::setBase(Ipv4AddressHelper &helper, int level, int clusterIndex)
+{
+    std::pair<Ipv4Address, Ipv4Mask> network = clusterNetwork(level, clusterIndex);
+    helper.SetBase(network.first, network.second);
+}
+
+// Interface of ipv4 whose network contains address (-1 if none)
+int32_t InterfaceTowards(Ptr<Ipv4> ipv4, Ipv4Address address)
+{
+    // Interface 0 is loopback
+    for (uint32_t i = 1; i < ipv4->GetNInterfaces(); i++)
+    {
+        for (uint32_t j = 0; j < ipv4->GetNAddresses(i); j++)
+        {
+            Ipv4InterfaceAddress ifAddr = ipv4->GetAddress(i, j);
+
+            if (ifAddr.GetLocal().CombineMask(ifAddr.GetMask()) == address.CombineMask(ifAddr.GetMask()))
+                return i;
+        }
+    }
+
+    return -1;
+}
+
+// Address of target on the network it shares with neighbour
+Ipv4Address AddressOnSharedNetwork(Ptr<Node> target, Ptr<Node> neighbour)
+{
+    Ptr<Ipv4> targetIpv4 = target->GetObject<Ipv4>();
+    Ptr<Ipv4> neighbourIpv4 = neighbour->GetObject<Ipv4>();
+
+    for (uint32_t i = 1; i < targetIpv4->GetNInterfaces(); i++)
+    {
+        for (uint32_t j = 0; j < targetIpv4->GetNAddresses(i); j++)
+        {
+            Ipv4Address local = targetIpv4->GetAddress(i, j).GetLocal();
+
+            if (InterfaceTowards(neighbourIpv4, local) >= 0)
+                return local;
+        }
+    }
+
+    NS_ABORT_MSG("Nodes " << target->GetId() << " and " << neighbour->GetId() << " don't share any network");
+    return Ipv4Address();
+}
+
+// Mobility trace sink, forwards the event to routing
+void HierarchicalRoutingCourseChange(HierarchicalRouting *routing, int level, int cluster, Ptr<const MobilityModel> model)
+{
+    routing->onGatewayCourseChange(level, cluster);
+}
+
+// Calculate and install routes for the whole hierarchy
+void HierarchicalRouting::build(std::vector<Level *> _levels, double _range)
+{
+    levels = _levels;
+    range = _range;
+
+    // Every node belongs to a first level cluster
+    for (uint32_t i = 0; i < levels[0]->clusters.size(); i++)
+    {
+        NodeContainer leafNodes = levels[0]->clusters[i].ns3Nodes;
+
+        for (uint32_t j = 0; j < leafNodes.GetN(); j++)
+            leafOf[leafNodes.Get(j)->GetId()] = i;
+    }
+
+    // Some of them also represent their cluster on upper levels
+    for (uint32_t l = 0; l < levels.size(); l++)
+    {
+        for (uint32_t i = 0; i < levels[l]->clusters.size(); i++)
+        {
+            Cluster &cluster = levels[l]->clusters[i];
+
+            if (cluster.parent >= 0)
+                gatewayRoles[cluster.gateway->GetId()].push_back(std::make_pair(l, i));
+        }
+    }
+
+    // Neighbourhood between gateways sharing an upper level cluster
+    for (uint32_t l = 1; l < levels.size(); l++)
+    {
+        for (uint32_t i = 0; i < levels[l]->clusters.size(); i++)
+        {
+            neighbourhoods[std::make_pair(l, i)] = calculateNeighbourhood(l, i);
+
+            // Routes only depend on positions when range is limited (and the level is wireless)
+            if (range <= 0 || (l < wiredLevels.size() && wiredLevels[l]))
+                continue;
+
+            for (int child : levels[l]->clusters[i].children)
+            {
+                Ptr<MobilityModel> mobility = levels[l - 1]->clusters[child].gateway->GetObject<MobilityModel>();
+                mobility->TraceConnectWithoutContext(
+                    "CourseChange", MakeBoundCallback(&HierarchicalRoutingCourseChange, this, (int)l, (int)i));
+            }
+        }
+    }
+
+    // Finally, install routes on every node
+    for (Cluster &cluster : levels[0]->clusters)
+    {
+        for (uint32_t j = 0; j < cluster.ns3Nodes.GetN(); j++)
+            installNode(cluster.ns3Nodes.Get(j));
+    }
+}
+
+// Recalculate routes of gateways attached to a cluster
+void HierarchicalRouting::recomputeCluster(int level, int clusterIndex)
+{
+    for (int child : levels[level]->clusters[clusterIndex].children)
+        installNode(levels[level - 1]->clusters[child].gateway);
+}
+
+// Only recompute when a gateway got in or out of range
+void HierarchicalRouting::onGatewayCourseChange(int level, int clusterIndex)
+{
+    std::vector<bool> neighbourhood = calculateNeighbourhood(level, clusterIndex);
+    std::pair<int, int> key = std::make_pair(level, clusterIndex);
+
+    if (neighbourhoods[key] == neighbourhood)
+        return;
+
+    neighbourhoods[key] = neighbourhood;
+    nRecomputations++;
+    recomputeCluster(level, clusterIndex);
+}
+
+// Adjacency matrix (flattened) between children gateways of a cluster
+std::vector<bool> HierarchicalRouting::calculateNeighbourhood(int level, int clusterIndex)
+{
+    std::vector<int> &children = levels[level]->clusters[clusterIndex].children;
+    int n = children.size();
+    std::vector<bool> neighbourhood(n * n, true);
+
+    if (range <= 0 || (level < (int)wiredLevels.size() && wiredLevels[level]))
+        return neighbourhood;
+
+    for (int a = 0; a < n; a++)
+    {
+        Vector posA = levels[level - 1]->clusters[children[a]].gateway->GetObject<MobilityModel>()->GetPosition();
+
+        for (int b = a + 1; b < n; b++)
+        {
+            Vector posB = levels[level - 1]->clusters[children[b]].gateway->GetObject<MobilityModel>()->GetPosition();
+            bool inRange = CalculateDistance(posA, posB) <= range;
+
+            neighbourhood[a * n + b] = inRange;
+            neighbourhood[b * n + a] = inRange;
+        }
+    }
+
+    return neighbourhood;
+}
+
+// Next hop from child gateway "from" to child gateway "to" (positions within children)
+Ipv4Address HierarchicalRouting::hopTowards(int level, int clusterIndex, int from, int to)
+{
+    std::vector<int> &children = levels[level]->clusters[clusterIndex].children;
+    Ptr<Node> fromNode = levels[level - 1]->clusters[children[from]].gateway;
+    int nextHop = to;
+
+    if (range > 0)
+    {
+        // Breadth first search, saving the first hop taken to reach each gateway
+        std::vector<bool> &neighbourhood = neighbourhoods[std::make_pair(level, clusterIndex)];
+        int n = children.size();
+        std::vector<int> firstHop(n, -1);
+        std::queue<int> pending;
+
+        firstHop[from] = from;
+        pending.push(from);
+
+        while (!pending.empty() && firstHop[to] < 0)
+        {
+            int current = pending.front();
+            pending.pop();
+
+            for (int next = 0; next < n; next++)
+            {
+                if (firstHop[next] >= 0 || !neighbourhood[current * n + next])
+                    continue;
+
+                firstHop[next] = current == from ? next : firstHop[current];
+                pending.push(next);
+            }
+        }
+
+        // Unreachable gateways are still tried directly
+        if (firstHop[to] >= 0)
+            nextHop = firstHop[to];
+    }
+
+    return AddressOnSharedNetwork(levels[level - 1]->clusters[children[nextHop]].gateway, fromNode);
+}
+
+// Calculate and install routes of a single node
+void HierarchicalRouting::installNode(Ptr<Node> node)
+{
+    uint32_t id = node->GetId();
+    std::vector<Route> routes;
+    bool hasDefault = false;
+    Ipv4Address defaultNextHop;
+
+    // Members reach everything through their head
+    Cluster &leaf = levels[0]->clusters[leafOf[id]];
+    if (leaf.gateway != node)
+    {
+        hasDefault = true;
+        defaultNextHop = AddressOnSharedNetwork(leaf.gateway, node);
+    }
+
+    std::map<uint32_t, std::vector<std::pair<int, int>>>::iterator roles = gatewayRoles.find(id);
+    if (roles != gatewayRoles.end())
+    {
+        for (std::pair<int, int> role : roles->second)
+        {
+            int l = role.first;
+            Cluster &cluster = levels[l]->clusters[role.second];
+
+            // Own subtree is reached through the first child's gateway
+            // (first level subtrees are directly connected)
+            if (l > 0)
+            {
+                Ptr<Node> inner = levels[l - 1]->clusters[cluster.children[0]].gateway;
+                Ipv4Address nextHop = AddressOnSharedNetwork(inner, node);
+
+                for (std::pair<Ipv4Address, Ipv4Mask> prefix : cluster.prefixes)
+                    routes.push_back({prefix.first, prefix.second, nextHop});
+            }
+
+            // Sibling subtrees are reached through their gateways on the upper level
+            Cluster &parent = levels[l + 1]->clusters[cluster.parent];
+            int self = std::find(parent.children.begin(), parent.children.end(), role.second) - parent.children.begin();
+
+            for (int k = 0; k < (int)parent.children.size(); k++)
+            {
+                if (k == self)
+                    continue;
+
+                Ipv4Address nextHop = hopTowards(l + 1, cluster.parent, self, k);
+
+                for (std::pair<Ipv4Address, Ipv4Mask> prefix : levels[l]->clusters[parent.children[k]].prefixes)
+                    routes.push_back({prefix.first, prefix.second, nextHop});
+            }
+
+            // Everything else goes up through parent's gateway
+            if (parent.parent >= 0)
+            {
+                hasDefault = true;
+
+                if (self == 0)
+                    defaultNextHop = AddressOnSharedNetwork(parent.gateway, node);
+                else
+                    defaultNextHop = hopTowards(l + 1, cluster.parent, self, 0);
+            }
+        }
+    }
+
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+
+    // Trie takes the routes when the node has one
+    Ptr<TrieRouting> trie = TrieRoutingHelper::GetTrieRouting(ipv4);
+    if (trie)
+    {
+        // Remove routes installed before (interface routes are kept)
+        nRoutes -= trie->RemoveRoutesWithMetric(routeMetric);
+
+        for (Route route : routes)
+            trie->AddNetworkRouteTo(
+                route.network, route.mask, route.nextHop, InterfaceTowards(ipv4, route.nextHop), routeMetric);
+
+        if (hasDefault)
+            trie->SetDefaultRoute(defaultNextHop, InterfaceTowards(ipv4, defaultNextHop), routeMetric);
+
+        nRoutes += routes.size() + (hasDefault ? 1 : 0);
+        return;
+    }
+
+    Ipv4StaticRoutingHelper staticRouting;
+    Ptr<Ipv4StaticRouting> table = staticRouting.GetStaticRouting(ipv4);
+
+    // Remove routes installed before (interface routes are kept)
+    for (uint32_t r = table->GetNRoutes(); r-- > 0;)
+    {
+        if (table->GetMetric(r) != routeMetric)
+            continue;
+
+        table->RemoveRoute(r);
+        nRoutes--;
+    }
+
+    for (Route route : routes)
+    {
+        table->AddNetworkRouteTo(
+            route.network, route.mask, route.nextHop, InterfaceTowards(ipv4, route.nextHop), routeMetric);
+        nRoutes++;
+    }
+
+    if (hasDefault)
+    {
+        table->SetDefaultRoute(defaultNextHop, InterfaceTowards(ipv4, defaultNextHop), routeMetric);
+        nRoutes++;
+    }
+}
+
+// Queues where a wifi device keeps data frames (one per access category on QoS MACs)
+std::vector<Ptr<WifiMacQueue>> DeviceQueues(Ptr<WifiNetDevice> device)
+{
+    BooleanValue qos;
+    device->GetMac()->GetAttribute("QosSupported", qos);
+
+    std::vector<std::string> attributes = {"Txop"};
+    if (qos.Get())
+        attributes = {"BE_Txop", "BK_Txop", "VI_Txop", "VO_Txop"};
+
+    std::vector<Ptr<WifiMacQueue>> queues;
+    for (std::string &attribute : attributes)
+    {
+        PointerValue txop;
+        device->GetMac()->GetAttribute(attribute, txop);
+        queues.push_back(txop.Get<Txop>()->GetWifiMacQueue());
+    }
+
+    return queues;
+}
+
+// Peak resident memory of current process (KiB), read from procfs (high water mark, as
+// memory freed before the run ends would hide what it needed)
+long GetPeakMemoryKb()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return std::atol(line.c_str() + 6);
+    }
+
+    return 0;
+}
+
+// Start peak memory over from current resident memory (the mark is per process, and
+// runs may follow each other in one)
+void ResetPeakMemory()
+{
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+}
+
+// Write results as "name value" lines
+std::string SerializeResult(const SimulationResult &result)
+{
+    std::stringstream ss;
+    ss.precision(17);
+
+    ss << "throughput " << result.throughput << "\n"
+       << "lossRate " << result.lossRate << "\n"
+       << "deliveryRatio " << result.deliveryRatio << "\n"
+       << "eventCount " << result.eventCount << "\n"
+       << "memoryKb " << result.memoryKb << "\n"
+       << "truncated " << result.truncated << "\n";
+
+    for (const std::pair<const std::string, double> &stat : result.stats)
+        ss << stat.first << " " << stat.second << "\n";
+
+    return ss.str();
+}
+
+// Read results written by SerializeResult
+SimulationResult ParseResult(const std::string &data)
+{
+    SimulationResult result;
+    std::stringstream ss(data);
+    std::string name;
+    double value;
+
+    while (ss >> name >> value)
+    {
+        if (name == "throughput")
+            result.throughput = value;
+        else if (name == "lossRate")
+            result.lossRate = value;
+        else if (name == "deliveryRatio")
+            result.deliveryRatio = value;
+        else if (name == "eventCount")
+            result.eventCount = (uint64_t)value;
+        else if (name == "memoryKb")
+            result.memoryKb = (long)value;
+        else if (name == "truncated")
+            result.truncated = value != 0;
+        else
+            result.stats[name] = value;
+    }
+
+    return result;
+}
+
+// Run an experiment in a child process, results come back through a pipe
+SimulationResult RunInChildProcess(Taller1Experiment &experiment)
+{
+    ChildRun child = StartChildRun(experiment);
+    while (!ReadChildRun(child))
+        ;
+
+    return FinishChildRun(experiment, child);
+}
+
+// Start a run (result is ready when cached)
+ChildRun StartChildRun(Taller1Experiment &experiment)
+{
+    // Parent keeps the parameters the child runs with, for saving them
+    experiment.normalize();
+
+    // No process needed for cached runs
+    ChildRun child;
+    if (experiment.cachedResult(child.result))
+        return child;
+
+    int fds[2];
+    NS_ABORT_MSG_IF(pipe(fds) != 0, "Couldn't create pipe");
+
+    std::cout.flush();
+    pid_t pid = fork();
+    NS_ABORT_MSG_IF(pid < 0, "Couldn't fork");
+
+    if (pid == 0)
+    {
+        close(fds[0]);
+
+        std::string data = SerializeResult(experiment.Run());
+        for (size_t written = 0; written < data.size();)
+        {
+            ssize_t n = write(fds[1], data.data() + written, data.size() - written);
+            if (n <= 0)
+                break;
+            written += n;
+        }
+
+        close(fds[1]);
+        std::cout.flush();
+        _exit(0);
+    }
+
+    close(fds[1]);
+
+    child.pid = pid;
+    child.fd = fds[0];
+
+    return child;
+}
+
+// Read what the child wrote so far, true once it's done writing (blocks until it writes)
+bool ReadChildRun(ChildRun &child)
+{
+    if (child.pid < 0)
+        return true;
+
+    char buffer[4096];
+    ssize_t n = read(child.fd, buffer, sizeof(buffer));
+    if (n > 0)
+        child.data.append(buffer, n);
+
+    return n <= 0;
+}
+
+// Wait for the child and take its result
+SimulationResult FinishChildRun(Taller1Experiment &experiment, ChildRun &child)
+{
+    if (child.pid < 0)
+        return child.result;
+
+    close(child.fd);
+    int status = 0;
+    waitpid(child.pid, &status, 0);
+
+    // Failed runs aren't cached
+    child.result = ParseResult(child.data);
+    child.result.failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0 || child.data.empty();
+    if (!child.result.failed)
+        experiment.cacheResult(child.result);
+
+    return child.result;
+}
+
+// Run experiments in child processes, up to a number at once (0 means one per core)
+// Results are in experiments order, new runs are appended to resultsFile (of the first)
+std::vector<SimulationResult> RunInChildProcesses(std::vector<Taller1Experiment> &experiments, int jobs)
+{
+    uint32_t nJobs = jobs > 0 ? jobs : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<SimulationResult> results(experiments.size());
+    if (experiments.empty())
+        return results;
+
+    // Runs are appended in groups, once each. Cache hits missing from resultsFile (still
+    // buffered when an earlier sweep was cut) are saved too
+    std::string resultsFile = experiments[0].resultsFile;
+    ResultStore store(resultsFile), details(resultsFile + ".details");
+    store.attachDetails(details);
+    std::set<std::string> savedRuns = resultsFile.empty() ? std::set<std::string>() : store.runIds();
+
+    // Runs going on, with their experiment index
+    std::vector<std::pair<uint32_t, ChildRun>> running;
+    uint32_t next = 0;
+
+    while (next < experiments.size() || !running.empty())
+    {
+        while (next < experiments.size() && running.size() < nJobs)
+        {
+            running.push_back(std::make_pair(next, StartChildRun(experiments[next])));
+            next++;
+        }
+
+        // Wait for some child to write (cached runs are ready already)
+        std::vector<pollfd> fds;
+        bool ready = false;
+        for (std::pair<uint32_t, ChildRun> &run : running)
+        {
+            fds.push_back({run.second.fd, POLLIN, 0});
+            ready |= run.second.pid < 0;
+        }
+        NS_ABORT_MSG_IF(poll(fds.data(), fds.size(), ready ? 0 : -1) < 0 && errno != EINTR, "Couldn't wait for runs");
+
+        for (uint32_t r = running.size(); r-- > 0;)
+        {
+            ChildRun &child = running[r].second;
+            if (child.pid >= 0 && (fds[r].revents == 0 || !ReadChildRun(child)))
+                continue;
+
+            Taller1Experiment &experiment = experiments[running[r].first];
+            results[running[r].first] = FinishChildRun(experiment, child);
+            if (!results[running[r].first].failed && savedRuns.insert(experiment.configKey()).second)
+                experiment.saveResult(results[running[r].first], store, details);
+
+            running.erase(running.begin() + r);
+        }
+    }
+
+    return results;
+}
+
+// Normal quantile, by bisection on its CDF
+double NormalQuantile(double p)
+{
+    double low = -10, high = 10, z = 0;
+    for (int i = 0; i < 60; i++)
+    {
+        z = (low + high) / 2;
+        if (0.5 * std::erfc(-z / std::sqrt(2.0)) < p)
+            low = z;
+        else
+            high = z;
+    }
+
+    return z;
+}
+
+// Student's t quantile, exact for 1 and 2 degrees of freedom, otherwise Cornish-Fisher
+// expansion around the normal one (Abramowitz and Stegun 26.7.5, within 1% from 3 on)
+double StudentQuantile(double p, int dof)
+{
+    if (dof == 1)
+        return std::tan(M_PI * (p - 0.5));
+    if (dof == 2)
+        return (2 * p - 1) / std::sqrt(2 * p * (1 - p));
+
+    double z = NormalQuantile(p);
+    double v = dof;
+    double z2 = z * z;
+
+    double g1 = (z2 + 1) * z / 4;
+    double g2 = ((5 * z2 + 16) * z2 + 3) * z / 96;
+    double g3 = (((3 * z2 + 19) * z2 + 17) * z2 - 15) * z / 384;
+    double g4 = ((((79 * z2 + 776) * z2 + 1482) * z2 - 1920) * z2 - 945) * z / 92160;
+
+    return z + g1 / v + g2 / (v * v) + g3 / (v * v * v) + g4 / (v * v * v * v);
+}
+
+// Whether a stat is per node or per channel (kept in result details, see ResultStore)
+// Those have a "node<id>" part, or start with "channel<index>"
+bool IsDetailStat(const std::string &name)
+{
+    // Part is prefix followed by a number
+    auto numbered = [](const std::string &part, const std::string &prefix) {
+        return part.size() > prefix.size() && part.compare(0, prefix.size(), prefix) == 0 &&
+               std::all_of(part.begin() + prefix.size(), part.end(), ::isdigit);
+    };
+
+    std::stringstream ss(name);
+    std::string part;
+
+    for (int p = 0; std::getline(ss, part, '.'); p++)
+    {
+        if (numbered(part, "node") || (p == 0 && numbered(part, "channel")))
+            return true;
+    }
+
+    return false;
+}
+
+// Integers of a comma separated list
+std::vector<int> ParseIntList(std::string list)
+{
+    std::vector<int> values;
+    std::stringstream ss(list);
+    std::string value;
+
+    while (std::getline(ss, value, ','))
+    {
+        if (!value.empty())
+            values.push_back(std::stoi(value));
+    }
+
+    return values;
+}
+
+// Seed of a sweep through cacheDir: the one given, else the one kept in cacheDir/seed
+// (picked from the clock the first time), so running the sweep again reuses its runs
+uint32_t SweepSeed(uint32_t seed, std::string cacheDir)
+{
+    if (seed != 0 || cacheDir.empty())
+        return seed != 0 ? seed : std::time(nullptr);
+
+    std::string path = cacheDir + "/seed";
+    std::ifstream kept(path);
+    if (kept >> seed && seed != 0)
+        return seed;
+
+    seed = std::time(nullptr);
+    mkdir(cacheDir.c_str(), 0755);
+    std::ofstream file(path);
+    NS_ABORT_MSG_IF(!(file << seed << "\n"), "Couldn't write " << path);
+
+    return seed;
+}
+
+// Final profile of each level
+std::vector<PhyProfile> Taller1Experiment::phyProfiles() const
+{
+    std::vector<PhyProfile> profiles(4);
+
+    profiles[0].manager = "aarf";
+    profiles[1].mode = secondLayerResources;
+
+    // Classes other than be need a queue per access category on every hop
+    NS_ABORT_MSG_IF(FlowClassTag::fromName(intraClusterClass) == FlowClassTag::N_CLASSES,
+                    "Unknown traffic class " << intraClusterClass);
+    NS_ABORT_MSG_IF(FlowClassTag::fromName(interClusterClass) == FlowClassTag::N_CLASSES,
+                    "Unknown traffic class " << interClusterClass);
+    for (int l = 0; l < 4; l++)
+        profiles[l].qos = intraClusterClass != "be" || interClusterClass != "be";
+
+    std::string overrides[4] = {phyProfile1, phyProfile2, phyProfile3, phyProfile4};
+    for (int l = 0; l < 4; l++)
+        profiles[l].apply(overrides[l]);
+
+    return profiles;
+}
+
+// Final backbone of each level (first level is always wifi)
+std::vector<BackboneProfile> Taller1Experiment::backbones() const
+{
+    std::vector<BackboneProfile> profiles(4);
+
+    std::string overrides[4] = {"", backbone2, backbone3, backbone4};
+    for (int l = 0; l < 4; l++)
+        profiles[l].apply(overrides[l]);
+
+    return profiles;
+}
+
+// Every parameter affecting results, as a ResultStore row
+ResultRow Taller1Experiment::parameters() const
+{
+    ResultRow row;
+
+    row.numbers["nLevels"] = nLevels;
+    row.numbers["nClusters_1st_level"] = nClusters_1st_level;
+    row.numbers["nNodes_pC_1st_level"] = nNodes_pC_1st_level;
+    row.numbers["nClusters_2nd_level"] = nClusters_2nd_level;
+    row.numbers["nNodes_pC_2nd_level"] = nNodes_pC_2nd_level;
+    row.numbers["nClusters_3rd_level"] = nClusters_3rd_level;
+    row.numbers["nNodes_pC_3rd_level"] = nNodes_pC_3rd_level;
+    row.numbers["width"] = width;
+    row.numbers["height"] = height;
+    row.numbers["probability"] = probability;
+    row.numbers["meanOffTime"] = meanOffTime;
+    row.numbers["trafficRatio"] = trafficRatio;
+    row.numbers["simulationTime"] = simulationTime;
+    row.numbers["seed"] = seed;
+    row.numbers["nFlows"] = nFlows;
+    row.numbers["intraClusterFraction"] = intraClusterFraction;
+    row.numbers["hotspotFraction"] = hotspotFraction;
+    row.numbers["routingRange"] = routingRange;
+    row.numbers["lossTarget"] = lossTarget;
+    row.numbers["throughputTarget"] = throughputTarget;
+    row.numbers["earlyStopConfidence"] = earlyStopConfidence;
+    row.numbers["earlyStopInterval"] = earlyStopInterval;
+    row.numbers["earlyStopMinPackets"] = earlyStopMinPackets;
+    row.numbers["headReport"] = headReport;
+    row.numbers["headSampleInterval"] = headSampleInterval;
+
+    for (size_t i = 0; i < firstLayerResources.size(); i++)
+        row.numbers["firstLayerResources." + std::to_string(i)] = firstLayerResources[i];
+
+    row.texts["secondLayerResources"] = secondLayerResources;
+    row.texts["trafficApplication"] = trafficApplication;
+    row.texts["trafficModel"] = trafficModel;
+    row.texts["intraClusterClass"] = intraClusterClass;
+    row.texts["interClusterClass"] = interClusterClass;
+    row.texts["trafficFile"] = trafficFile;
+    row.texts["traceFile"] = traceFile;
+    row.texts["addressPlan"] = addressPlan;
+    row.texts["routingMode"] = routingMode;
+    row.texts["routeLookup"] = routeLookup;
+    row.texts["channelPlan"] = channelPlan;
+    row.texts["admission"] = admission;
+    row.numbers["headRotationInterval"] = headRotationInterval;
+    row.numbers["headCandidates"] = headCandidates;
+    row.numbers["headRotationHysteresis"] = headRotationHysteresis;
+    row.numbers["admissionBurst"] = admissionBurst;
+    row.numbers["gateways1"] = gateways1;
+    row.numbers["gateways2"] = gateways2;
+    row.numbers["gateways3"] = gateways3;
+    row.texts["gatewaySelection"] = gatewaySelection;
+    row.numbers["admissionHeadroom"] = admissionHeadroom;
+
+    std::vector<PhyProfile> profiles = phyProfiles();
+    for (size_t l = 0; l < profiles.size(); l++)
+        row.texts["phyProfile" + std::to_string(l + 1)] = profiles[l].describe();
+
+    std::vector<BackboneProfile> levelBackbones = backbones();
+    for (size_t l = 1; l < levelBackbones.size(); l++)
+        row.texts["backbone" + std::to_string(l + 1)] = levelBackbones[l].describe();
+    row.numbers["nChannels"] = nChannels;
+    row.numbers["interferenceRange"] = interferenceRange;
+
+    return row;
+}
+
+// Parameters and results of a run as a ResultStore row
+ResultRow Taller1Experiment::describe(const SimulationResult &result) const
+{
+    ResultRow row = parameters();
+
+    row.numbers["throughput"] = result.throughput;
+    row.numbers["lossRate"] = result.lossRate;
+    row.numbers["deliveryRatio"] = result.deliveryRatio;
+    row.numbers["eventCount"] = result.eventCount;
+    row.numbers["memoryKb"] = result.memoryKb;
+    row.numbers["truncated"] = result.truncated;
+    row.texts["runId"] = configKey();
+
+    for (const std::pair<const std::string, double> &stat : result.stats)
+    {
+        if (!IsDetailStat(stat.first))
+            row.numbers[stat.first] = stat.second;
+    }
+
+    return row;
+}
+
+// Per node and per channel stats of a run, a (runId, stat, value) row each
+std::vector<ResultRow> Taller1Experiment::details(const SimulationResult &result) const
+{
+    std::vector<ResultRow> rows;
+    std::string runId = configKey();
+
+    for (const std::pair<const std::string, double> &stat : result.stats)
+    {
+        if (!IsDetailStat(stat.first))
+            continue;
+
+        ResultRow row;
+        row.texts["runId"] = runId;
+        row.texts["stat"] = stat.first;
+        row.numbers["value"] = stat.second;
+        rows.push_back(row);
+    }
+
+    return rows;
+}
+
+// Append run to resultsFile, and its details to resultsFile.details, if any
+void Taller1Experiment::saveResult(const SimulationResult &result) const
+{
+    if (resultsFile.empty())
+        return;
+
+    ResultStore results(resultsFile), details(resultsFile + ".details");
+    saveResult(result, results, details);
+}
+
+// Same, through stores of a sweep (which append many runs at once)
+void Taller1Experiment::saveResult(const SimulationResult &result, ResultStore &results, ResultStore &runDetails) const
+{
+    if (resultsFile.empty())
+        return;
+
+    results.add(describe(result));
+    for (const ResultRow &row : details(result))
+        runDetails.add(row);
+}
+
+// FNV-1a hash
+static uint64_t HashBytes(const char *data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL)
+{
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ (uint8_t)data[i]) * 0x100000001b3ULL;
+
+    return hash;
+}
+
+// Hash of the running executable, so every build that may change results of a
+// configuration has cached runs of its own (build time when it can't be read)
+static std::string CodeVersion()
+{
+    static std::string version;
+    if (!version.empty())
+        return version;
+
+    std::ifstream file("/proc/self/exe", std::ios::binary);
+    uint64_t hash = HashBytes(__DATE__ " " __TIME__, sizeof(__DATE__ " " __TIME__) - 1);
+    if (file.is_open())
+    {
+        hash = HashBytes("", 0);
+        char buffer[1 << 16];
+        while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+            hash = HashBytes(buffer, file.gcount(), hash);
+    }
+
+    char text[17];
+    snprintf(text, sizeof(text), "%016llx", (unsigned long long)hash);
+    version = text;
+
+    return version;
+}
+
+// Hash of parameters, files they name and code version (empty when runs can't be repeated)
+std::string Taller1Experiment::configKey() const
+{
+    // Seed taken from time isn't known before running
+    if (seed == 0)
+        return "";
+
+    // Canonical form: sorted "name=value" lines, numbers with every digit
+    ResultRow row = parameters();
+    std::stringstream ss;
+    ss.precision(17);
+    ss << "version=" << CodeVersion() << "\n";
+
+    for (const std::pair<const std::string, double> &number : row.numbers)
+        ss << number.first << "=" << number.second << "\n";
+    for (const std::pair<const std::string, std::string> &text : row.texts)
+        ss << text.first << "=" << text.second << "\n";
+
+    std::string canonical = ss.str();
+    uint64_t hash = HashBytes(canonical.data(), canonical.size());
+
+    // Content of input files counts, not their names
+    for (const std::string &path : {trafficFile, traceFile})
+    {
+        if (path.empty())
+            continue;
+
+        std::ifstream file(path, std::ios::binary);
+        char buffer[1 << 16];
+        while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+            hash = HashBytes(buffer, file.gcount(), hash);
+    }
+
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+    return key;
+}
+
+// Look for a run of this configuration in cacheDir
+bool Taller1Experiment::cachedResult(SimulationResult &result) const
+{
+    std::string key = configKey();
+    if (cacheDir.empty() || key.empty())
+        return false;
+
+    std::ifstream file(cacheDir + "/" + key + ".result");
+    if (!file.is_open())
+        return false;
+
+    std::stringstream ss;
+    ss << file.rdbuf();
+    result = ParseResult(ss.str());
+    result.cached = true;
+
+    std::cout << "Cached result " << key << std::endl;
+    return true;
+}
+
+// Save a run to cacheDir (written aside and renamed, so readers never see half a file)
+void Taller1Experiment::cacheResult(const SimulationResult &result) const
+{
+    std::string key = configKey();
+    if (cacheDir.empty() || key.empty())
+        return;
+
+    mkdir(cacheDir.c_str(), 0755);
+
+    std::string path = cacheDir + "/" + key + ".result";
+    std::string temporary = path + "." + std::to_string(getpid());
+    {
+        std::ofstream file(temporary);
+        NS_ABORT_MSG_IF(!file.is_open(), "Couldn't write cache in " << cacheDir);
+        file << SerializeResult(result);
+    }
+
+    NS_ABORT_MSG_IF(std::rename(temporary.c_str(), path.c_str()) != 0, "Couldn't write " << path);
+}
+
+// Run, unless configuration is in cacheDir
+SimulationResult Taller1Experiment::RunCached()
+{
+    normalize();
+
+    SimulationResult result;
+    if (cachedResult(result))
+        return result;
+
+    result = Run();
+    cacheResult(result);
+
+    return result;
+}
+
+// Row groups are framed by these, so truncated ones can be told apart
+static const uint32_t ROW_GROUP_MAGIC = 0x47523154; // "T1RG"
+static const uint32_t ROW_GROUP_END = 0x45523154;   // "T1RE"
+
+// Column types in row groups
+enum ResultColumnType : uint8_t
+{
+    NUMBER_COLUMN = 0,
+    TEXT_COLUMN = 1
+};
+
+ResultStore::ResultStore(std::string _path)
+    : path(_path)
+{
+}
+
+// Append rows still waiting
+ResultStore::~ResultStore()
+{
+    flush();
+
+    if (detailsStore)
+        detailsStore->rowsStore = NULL;
+    if (rowsStore)
+        rowsStore->detailsStore = NULL;
+}
+
+// Keep a row to append with others (appended once GROUP_ROWS are waiting, details wait
+// for their rows)
+void ResultStore::add(const ResultRow &row)
+{
+    pending.push_back(row);
+    if (!rowsStore && pending.size() >= GROUP_ROWS)
+        flush();
+}
+
+// Append rows waiting as a single group (after details waiting)
+void ResultStore::flush()
+{
+    if (detailsStore)
+        detailsStore->flush();
+
+    append(pending);
+    pending.clear();
+}
+
+// Store with details of the rows added here
+void ResultStore::attachDetails(ResultStore &details)
+{
+    detailsStore = &details;
+    details.rowsStore = this;
+}
+
+// Group layout (host byte order):
+// magic, payload size (u64), rows (u32), columns (u32), payload, end magic
+// Payload has, for each column: type (u8), name length (u16), name, values
+// Numbers are stored as doubles, texts as length (u32) and bytes
+void ResultStore::append(const std::vector<ResultRow> &rows)
+{
+    if (rows.empty())
+        return;
+
+    // Schema of this group is the union of row columns
+    std::map<std::string, ResultColumnType> columns;
+    for (const ResultRow &row : rows)
+    {
+        for (const std::pair<const std::string, double> &number : row.numbers)
+            columns.emplace(number.first, NUMBER_COLUMN);
+        for (const std::pair<const std::string, std::string> &text : row.texts)
+            columns.emplace(text.first, TEXT_COLUMN);
+    }
+
+    std::string payload;
+    auto put = [&payload](const void *data, size_t size) { payload.append((const char *)data, size); };
+
+    for (const std::pair<const std::string, ResultColumnType> &column : columns)
+    {
+        uint8_t type = column.second;
+        uint16_t nameLength = column.first.size();
+        put(&type, sizeof(type));
+        put(&nameLength, sizeof(nameLength));
+        put(column.first.data(), nameLength);
+
+        for (const ResultRow &row : rows)
+        {
+            if (column.second == NUMBER_COLUMN)
+            {
+                std::map<std::string, double>::const_iterator it = row.numbers.find(column.first);
+                double value = it != row.numbers.end() ? it->second : NAN;
+                put(&value, sizeof(value));
+            }
+            else
+            {
+                std::map<std::string, std::string>::const_iterator it = row.texts.find(column.first);
+                std::string value = it != row.texts.end() ? it->second : "";
+                uint32_t length = value.size();
+                put(&length, sizeof(length));
+                put(value.data(), length);
+            }
+        }
+    }
+
+    std::string group;
+    uint64_t payloadSize = payload.size();
+    uint32_t nRows = rows.size(), nColumns = columns.size();
+    group.append((const char *)&ROW_GROUP_MAGIC, sizeof(ROW_GROUP_MAGIC));
+    group.append((const char *)&payloadSize, sizeof(payloadSize));
+    group.append((const char *)&nRows, sizeof(nRows));
+    group.append((const char *)&nColumns, sizeof(nColumns));
+    group.append(payload);
+    group.append((const char *)&ROW_GROUP_END, sizeof(ROW_GROUP_END));
+
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    NS_ABORT_MSG_IF(fd < 0, "Couldn't open results file " << path);
+    NS_ABORT_MSG_IF(flock(fd, LOCK_EX) != 0, "Couldn't lock results file " << path);
+
+    for (size_t written = 0; written < group.size();)
+    {
+        ssize_t n = write(fd, group.data() + written, group.size() - written);
+        NS_ABORT_MSG_IF(n <= 0, "Couldn't write results file " << path);
+        written += n;
+    }
+
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+// Read every group
+ResultTable ResultStore::load() const
+{
+    ResultTable table;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return table;
+
+    // Whole file at once, groups being written meanwhile are left for later
+    flock(fd, LOCK_SH);
+    std::string data;
+    char buffer[1 << 16];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+        data.append(buffer, n);
+    flock(fd, LOCK_UN);
+    close(fd);
+
+    const size_t headerSize = 4 + 8 + 4 + 4;
+    size_t offset = 0;
+
+    while (offset + headerSize + 4 <= data.size())
+    {
+        uint32_t magic, nRows, nColumns;
+        uint64_t payloadSize;
+        std::memcpy(&magic, &data[offset], 4);
+        std::memcpy(&payloadSize, &data[offset + 4], 8);
+        std::memcpy(&nRows, &data[offset + 12], 4);
+        std::memcpy(&nColumns, &data[offset + 16], 4);
+
+        uint32_t end = 0;
+        bool complete = magic == ROW_GROUP_MAGIC && payloadSize <= data.size() - offset - headerSize - 4;
+        if (complete)
+            std::memcpy(&end, &data[offset + headerSize + payloadSize], 4);
+
+        // Cut group, go on from next one
+        if (!complete || end != ROW_GROUP_END)
+        {
+            size_t next = data.find(std::string((const char *)&ROW_GROUP_MAGIC, 4), offset + 1);
+            if (next == std::string::npos)
+                break;
+            offset = next;
+            continue;
+        }
+
+        const char *p = &data[offset + headerSize];
+        for (uint32_t c = 0; c < nColumns; c++)
+        {
+            uint8_t type = *p;
+            uint16_t nameLength;
+            std::memcpy(&nameLength, p + 1, 2);
+            std::string name(p + 3, nameLength);
+            p += 3 + nameLength;
+
+            if (type == NUMBER_COLUMN)
+            {
+                // Earlier rows without this column are NaN
+                std::vector<double> &column = table.numbers[name];
+                column.resize(table.nRows, NAN);
+                column.resize(table.nRows + nRows);
+                std::memcpy(&column[table.nRows], p, nRows * sizeof(double));
+                p += nRows * sizeof(double);
+            }
+            else
+            {
+                std::vector<std::string> &column = table.texts[name];
+                column.resize(table.nRows);
+                for (uint32_t r = 0; r < nRows; r++)
+                {
+                    uint32_t length;
+                    std::memcpy(&length, p, 4);
+                    column.emplace_back(p + 4, length);
+                    p += 4 + length;
+                }
+            }
+        }
+
+        table.nRows += nRows;
+        offset += headerSize + payloadSize + 4;
+    }
+
+    // Columns missing from last groups
+    for (std::pair<const std::string, std::vector<double>> &column : table.numbers)
+        column.second.resize(table.nRows, NAN);
+    for (std::pair<const std::string, std::vector<std::string>> &column : table.texts)
+        column.second.resize(table.nRows);
+
+    return table;
+}
+
+// Run ids (runId column) of every row
+std::set<std::string> ResultStore::runIds() const
+{
+    ResultTable table = load();
+    std::map<std::string, std::vector<std::string>>::iterator column = table.texts.find("runId");
+    if (column == table.texts.end())
+        return std::set<std::string>();
+
+    return std::set<std::string>(column->second.begin(), column->second.end());
+}
+
+// Write every row as CSV (columns sorted by name, numbers first)
+void ResultStore::exportCsv(std::string csvPath) const
+{
+    ResultTable table = load();
+
+    std::ofstream csv(csvPath);
+    NS_ABORT_MSG_IF(!csv.is_open(), "Couldn't open " << csvPath);
+    csv.precision(17);
+
+    // Texts are quoted when needed
+    auto quote = [](const std::string &text) {
+        if (text.find_first_of(",\"\n") == std::string::npos)
+            return text;
+
+        std::string quoted = "\"";
+        for (char c : text)
+            quoted += c == '"' ? std::string("\"\"") : std::string(1, c);
+        return quoted + "\"";
+    };
+
+    bool first = true;
+    for (const std::pair<const std::string, std::vector<double>> &column : table.numbers)
+    {
+        csv << (first ? "" : ",") << quote(column.first);
+        first = false;
+    }
+    for (const std::pair<const std::string, std::vector<std::string>> &column : table.texts)
+    {
+        csv << (first ? "" : ",") << quote(column.first);
+        first = false;
+    }
+    csv << "\n";
+
+    for (uint64_t r = 0; r < table.nRows; r++)
+    {
+        first = true;
+        for (const std::pair<const std::string, std::vector<double>> &column : table.numbers)
+        {
+            csv << (first ? "" : ",");
+            if (!std::isnan(column.second[r]))
+                csv << column.second[r];
+            first = false;
+        }
+        for (const std::pair<const std::string, std::vector<std::string>> &column : table.texts)
+        {
+            csv << (first ? "" : ",") << quote(column.second[r]);
+            first = false;
+        }
+        csv << "\n";
+    }
+}
+
+// Open journal, reading what an earlier run left
+SweepJournal::SweepJournal(std::string path)
+{
+    fd = open(path.c_str(), O_RDWR | O_APPEND | O_CREAT, 0644);
+    NS_ABORT_MSG_IF(fd < 0, "Couldn't open journal " << path);
+    NS_ABORT_MSG_IF(flock(fd, LOCK_EX | LOCK_NB) != 0, "Journal " << path << " is used by another sweep");
+
+    std::string data;
+    char buffer[1 << 16];
+    ssize_t n;
+    while ((n = pread(fd, buffer, sizeof(buffer), data.size())) > 0)
+        data.append(buffer, n);
+
+    // Drop line cut by a crash, so new lines don't get glued to it
+    size_t validSize = data.rfind('\n') == std::string::npos ? 0 : data.rfind('\n') + 1;
+    if (validSize < data.size())
+    {
+        NS_ABORT_MSG_IF(ftruncate(fd, validSize) != 0, "Couldn't repair journal " << path);
+        data.resize(validSize);
+    }
+
+    std::stringstream lines(data);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        size_t mark = line.rfind(" #");
+        if (mark == std::string::npos)
+            continue;
+
+        char checksum[17];
+        snprintf(checksum, sizeof(checksum), "%016llx", (unsigned long long)HashBytes(line.data(), mark));
+        if (line.compare(mark + 2, std::string::npos, checksum) != 0)
+            continue;
+
+        std::stringstream ss(line.substr(0, mark));
+        std::string kind;
+        uint32_t index;
+        ss >> kind;
+
+        if (kind == "SWEEP")
+            ss >> sweepId;
+        else if (kind == "PLAN" && ss >> index)
+        {
+            std::vector<double> &values = planned[index];
+            values.clear();
+
+            double value;
+            while (ss >> value)
+                values.push_back(value);
+        }
+        else if (kind == "DONE" && ss >> index)
+        {
+            std::string rest;
+            std::getline(ss, rest);
+            done[index] = ParseResult(rest);
+        }
+    }
+
+    // New journal
+    if (sweepId.empty())
+    {
+        char id[17];
+        snprintf(id, sizeof(id), "%08lx%08x", (unsigned long)std::time(nullptr), (unsigned)getpid());
+        sweepId = id;
+        writeLine("SWEEP " + sweepId);
+    }
+}
+
+SweepJournal::~SweepJournal()
+{
+    close(fd);
+}
+
+// Record case parameters before running it
+void SweepJournal::plan(uint32_t index, const std::vector<double> &values)
+{
+    std::stringstream ss;
+    ss.precision(17);
+    ss << "PLAN " << index;
+    for (double value : values)
+        ss << " " << value;
+
+    writeLine(ss.str());
+    planned[index] = values;
+}
+
+// Record case results (serialized results, on a single line)
+void SweepJournal::complete(uint32_t index, const SimulationResult &result)
+{
+    std::string data = SerializeResult(result);
+    std::replace(data.begin(), data.end(), '\n', ' ');
+
+    writeLine("DONE " + std::to_string(index) + " " + data);
+    done[index] = result;
+}
+
+// Append line with its checksum and sync
+void SweepJournal::writeLine(std::string line)
+{
+    char checksum[17];
+    snprintf(checksum, sizeof(checksum), "%016llx", (unsigned long long)HashBytes(line.data(), line.size()));
+    line += " #" + std::string(checksum) + "\n";
+
+    for (size_t written = 0; written < line.size();)
+    {
+        ssize_t n = write(fd, line.data() + written, line.size() - written);
+        NS_ABORT_MSG_IF(n <= 0, "Couldn't write journal");
+        written += n;
+    }
+
+    NS_ABORT_MSG_IF(fsync(fd) != 0, "Couldn't sync journal");
+}
+
+// Default constructor
+Taller1Experiment::Taller1Experiment()
+    // Default port to 9
+    : port(9),
+      // Default number of levels to 2
+      nLevels(2),
+      // Default number of clusters in 1st level to 6
+      nClusters_1st_level(6),
+      // Default number of nodes per cluster in 1st level to 6
+      nNodes_pC_1st_level(6),
+      // Default number of clusters in 2nd level to 2
+      nClusters_2nd_level(1),
+      // Default number of nodes per cluster in 2nd level to 2
+      nNodes_pC_2nd_level(6),
+      // Default number of clusters in 3rd level to 1
+      nClusters_3rd_level(1),
+      // Default number of nodes per cluster in 3rd level to 2
+      nNodes_pC_3rd_level(1),
+      // Default width to 500
+      width(100),
+      // Default height to 500
+      height(100)
+{
+}
+
+// Receive and set command line arguments
+void Taller1Experiment::HandleCommandLineArgs(int argc, char **argv, double resources[])
+{
+    /*
+     * Get console parameters
+     */
+    CommandLine cmd(__FILE__);
+
+    // Solving a bug which doesn't allow you to read integers from command line
+    double nc1l = nClusters_1st_level;
+    double nn1l = nNodes_pC_1st_level;
+    double nc2l = nClusters_2nd_level;
+    double nn2l = nNodes_pC_2nd_level;
+    double nc3l = nClusters_3rd_level;
+    double nn3l = nNodes_pC_3rd_level;
+    double nlevels = nLevels;
+
+    // Number of hierarchy levels
+    cmd.AddValue("nLevels", "Number of levels of this cluster", nlevels);
+
+    // Data for first level
+    cmd.AddValue("nClusters_1st_level", "Number of clusters in 1st level", nc1l);
+    cmd.AddValue("nNodes_pC_1st_level", "Number of nodes per cluster in 1st level", nn1l);
+
+    // Data for second level
+    cmd.AddValue("nClusters_2nd_level", "Number of clusters in 2nd level", nc2l);
+    cmd.AddValue("nNodes_pC_2nd_level", "Number of nodes per cluster in 2nd level", nn2l);
+
+    // Data for third level
+    cmd.AddValue("nClusters_3rd_level", "Number of clusters in 3rd level", nc3l);
+    cmd.AddValue("nNodes_pC_3rd_level", "Number of nodes per cluster in 3rd level", nn3l);
+
+    // Second level resources
+    cmd.AddValue("secondLayerResources", "Resources for second layer", secondLayerResources);
+
+    // Traffic ratio and mean offtime params
+    cmd.AddValue("trafficRatio", "Traffic ratio per node", trafficRatio);
+    cmd.AddValue("meanOffTime", "Mean offtime per node", meanOffTime);
+
+    // Traffic matrix
+    cmd.AddValue("trafficApplication", "Application for flows (multiflow, onoff)", trafficApplication);
+    cmd.AddValue("trafficModel", "Model for generated flows (uniform, gravity, hotspot)", trafficModel);
+    cmd.AddValue("nFlows", "Number of flows to generate", nFlows);
+    cmd.AddValue("intraClusterFraction", "Portion of flows inside their cluster (negative = any)", intraClusterFraction);
+    cmd.AddValue("hotspotFraction", "Portion of flows going to a head with hotspot model", hotspotFraction);
+    cmd.AddValue("intraClusterClass", "Traffic class of flows inside a cluster (be, bk, vi, vo)", intraClusterClass);
+    cmd.AddValue("interClusterClass", "Traffic class of flows between clusters (be, bk, vi, vo)", interClusterClass);
+    cmd.AddValue("trafficFile", "CSV with flows (srcCluster,srcNode,dstCluster,dstNode)", trafficFile);
+    cmd.AddValue("traceFile", "Trace to replay instead of flows (CSV time,size,src,dst or pcap)", traceFile);
+    cmd.AddValue("traceReadAhead", "Trace records kept in memory ahead of simulation", traceReadAhead);
+
+    // Space bounds
+    cmd.AddValue("width", "Width of the space", width);
+    cmd.AddValue("height", "Height of the space", height);
+
+    // Simulation time
+    cmd.AddValue("simulationTime", "Simulation time in seconds", simulationTime);
+
+    // Reproducibility
+    cmd.AddValue("seed", "Seed for random generators (0 to take current time)", seed);
+
+    // Routing
+    cmd.AddValue("routingMode", "Routing for the hierarchy (olsr, hierarchical)", routingMode);
+    cmd.AddValue("addressPlan", "How addresses are given to clusters (flat, hierarchical)", addressPlan);
+    cmd.AddValue("routeLookup", "Table for hierarchical routes (trie, linear)", routeLookup);
+    cmd.AddValue("routingRange", "Max distance between neighbour gateways for hierarchical routing (0 = no limit)", routingRange);
+
+    // PHY profiles
+    cmd.AddValue("phyProfile1", "PHY profile of first level (standard=,width=,manager=,mode=,ampdu=,amsdu=,qos=,<ac>.<attribute>=)", phyProfile1);
+    cmd.AddValue("phyProfile2", "PHY profile of second level", phyProfile2);
+    cmd.AddValue("phyProfile3", "PHY profile of third level", phyProfile3);
+    cmd.AddValue("phyProfile4", "PHY profile of fourth level", phyProfile4);
+
+    // Wired backbones
+    cmd.AddValue("backbone2", "Medium of second level (wifi, csma, p2p, plus rate=,delay=,qdisc=)", backbone2);
+    cmd.AddValue("backbone3", "Medium of third level", backbone3);
+    cmd.AddValue("backbone4", "Medium of fourth level", backbone4);
+
+    // Spectrum
+    cmd.AddValue("channelPlan", "Channels of first level clusters (private, dsatur, greedy, roundRobin)", channelPlan);
+    cmd.AddValue("nChannels", "Channels shared by first level clusters when not private", nChannels);
+    cmd.AddValue("interferenceRange", "Distance between heads for clusters to interfere (m)", interferenceRange);
+
+    // Targets and early stop
+    cmd.AddValue("lossTarget", "Highest loss rate accepted (negative means no target)", lossTarget);
+    cmd.AddValue("throughputTarget", "Lowest throughput accepted in Pkt/s (0 means no target)", throughputTarget);
+    cmd.AddValue("earlyStopConfidence", "Confidence needed to stop a run once its outcome is known", earlyStopConfidence);
+    cmd.AddValue("earlyStopInterval", "Seconds between early stop checks", earlyStopInterval);
+    cmd.AddValue("earlyStopMinPackets", "Packets sent before deciding on any target", earlyStopMinPackets);
+
+    // Time series
+    cmd.AddValue("timeSeriesFile", "CSV where level metrics are sampled along the run", timeSeriesFile);
+    cmd.AddValue("timeSeriesInterval", "Seconds between time series samples", timeSeriesInterval);
+    cmd.AddValue("timeSeriesBuffer", "Time series samples kept in memory before writing", timeSeriesBuffer);
+
+    // Heads load
+    cmd.AddValue("headReport", "Most loaded heads reported per level (0 means heads aren't watched)", headReport);
+    cmd.AddValue("headSampleInterval", "Seconds between head queue samples", headSampleInterval);
+
+    // Head rotation
+    cmd.AddValue("headRotationInterval", "Seconds between head elections (0 means heads don't change)", headRotationInterval);
+    cmd.AddValue("headCandidates", "Nodes able to head a first level cluster", headCandidates);
+    cmd.AddValue("headRotationHysteresis", "Margin a candidate must beat the head by", headRotationHysteresis);
+
+    // Multi-head clusters
+    cmd.AddValue("gateways1", "Nodes of each first level cluster attached to second level", gateways1);
+    cmd.AddValue("gateways2", "Nodes of each second level cluster attached to third level", gateways2);
+    cmd.AddValue("gateways3", "Nodes of each third level cluster attached to fourth level", gateways3);
+    cmd.AddValue("gatewaySelection", "How members pick first level gateways (hash, leastLoad)", gatewaySelection);
+
+    // Growth factor estimation
+    cmd.AddValue("jobs", "Runs at once in parallel sweeps (0 means one per core)", jobs);
+    cmd.AddValue("growthLevels", "Level counts swept by estimateGrowth (comma separated)", growthLevels);
+    cmd.AddValue("growthSizes", "First level clusters swept by estimateGrowth (comma separated)", growthSizes);
+    cmd.AddValue("growthReplications", "Seeds searched per size", growthReplications);
+    cmd.AddValue("growthMinResources", "Lowest resources per first level cluster searched", growthMinResources);
+    cmd.AddValue("growthMaxResources", "Highest resources per first level cluster searched", growthMaxResources);
+    cmd.AddValue("growthGridSize", "Resource levels between lowest and highest (geometric)", growthGridSize);
+    cmd.AddValue("growthConfidence", "Confidence of fitted growth factors", growthConfidence);
+    cmd.AddValue("growthFile", "CSV of resources found by each search", growthFile);
+
+    // Pareto frontier exploration
+    cmd.AddValue("paretoPopulation", "Configurations per generation of explorePareto", paretoPopulation);
+    cmd.AddValue("paretoGenerations", "Generations of explorePareto", paretoGenerations);
+    cmd.AddValue("paretoMinResources", "Lowest resources per first level cluster explored", paretoMinResources);
+    cmd.AddValue("paretoMaxResources", "Highest resources per first level cluster explored", paretoMaxResources);
+    cmd.AddValue("paretoRates", "Second level modes explored (comma separated, OfdmRate...Mbps)", paretoRates);
+    cmd.AddValue("paretoMutation", "Deviation of log resources when mutating", paretoMutation);
+    cmd.AddValue("paretoFile", "CSV of the frontier", paretoFile);
+
+    // Admission control
+    cmd.AddValue("admission", "Admission control at first level heads (off, police, shape)", admission);
+    cmd.AddValue("admissionBurst", "Seconds of a member's resources its token bucket holds", admissionBurst);
+    cmd.AddValue("admissionHeadroom", "Admission budgets are resources times this", admissionHeadroom);
+
+    // What to run
+    cmd.AddValue("mode", "What to run (single, testPhyRatio, compareRouting, compareAdmission, compareRotation, compareGateways, estimateGrowth, explorePareto, benchmarkLookup, exportResults)", mode);
+
+    // Results output
+    cmd.AddValue("resultsFile", "Columnar file where results of runs are appended", resultsFile);
+    cmd.AddValue("csvFile", "CSV written from resultsFile in exportResults mode", csvFile);
+    cmd.AddValue("cacheDir", "Directory where results are cached by configuration (needs a seed, sweeps keep theirs there)", cacheDir);
+    cmd.AddValue("journalFile", "Journal of sweep cases, a sweep started with it resumes where it stopped", journalFile);
+
+    // Parse arguments
+    cmd.Parse(argc, argv);
+
+    // Set values to class attributes
+    nLevels = (int)nlevels;
+    nClusters_1st_level = (int)nc1l;
+    nNodes_pC_1st_level = (int)nn1l;
+    nClusters_2nd_level = (int)nc2l;
+    nNodes_pC_2nd_level = (int)nn2l;
+    nClusters_3rd_level = (int)nc3l;
+    nNodes_pC_3rd_level = (int)nn3l;
+
+    // Set further arguments
+
+    // Set values to vector of resources on First Layer
+    // Its size should match the number of first layer cluster
+
+    firstLayerResources = std::vector<double>(
+        resources, resources + nClusters_1st_level);
+}
+
+// Fill parameters Run derives (sizes of top levels, seed taken from the clock), so runs
+// are hashed, cached and saved as they actually run
+void Taller1Experiment::normalize()
+{
+    // Seed taken from time is kept, so saved results can be repeated too
+    if (seed == 0)
+        seed = std::time(nullptr);
+
+    // Top levels always have a single cluster, whose nodes are heads of the level below
+    // (the address plan needs to know final fan-outs before creating any cluster)
+    if (nLevels == 2)
+    {
+        // In a two layer architecture, there is actually one single cluster in second level
+        // And its nodes are sublayer's clusters heads
+        nClusters_2nd_level = 1;
+        nNodes_pC_2nd_level = nClusters_1st_level;
+    }
+
+    if (nLevels == 3)
+    {
+        // In a three layer architecture, there is actually one single cluster in third level
+        // And its nodes are sublayer's clusters heads
+        nClusters_3rd_level = 1;
+        nNodes_pC_3rd_level = nClusters_2nd_level;
+    }
+}
+
+SimulationResult Taller1Experiment::Run()
+{
+    bool verbose = true;
+
+    // Randomize (unless a seed was given, so runs can be repeated)
+    normalize();
+    std::srand(seed);
+    RngSeedManager::SetSeed(std::rand());
+
+    // Peak memory of this run only
+    ResetPeakMemory();
+
+    if (verbose)
+        std::cout << "Starting configuration..." << std::endl;
+
+    //
+    // Configure physical layer
+    //
+
+    // Wifi channel
+    YansWifiChannelHelper channel = YansWifiChannelHelper::Default();
+
+    // Using friss propagation loss model
+    // It considers variables such as waves distortion due to obstacles, diffraction and related phenomena
+    channel.AddPropagationLoss(
+        "ns3::FriisPropagationLossModel");
+
+    // Use constant speed propagation delay model
+    channel.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
+
+    // Configure transmission channel
+    YansWifiPhyHelper phy;
+
+    phy.Set("TxPowerStart", DoubleValue(100.0));
+    phy.Set("TxPowerEnd", DoubleValue(100.0));
+
+    // Define speed (Which is distributed uniformly between 0 and 1 (units are m/s))
+    double nodeMinSpeed = 0.0, nodeMaxSpeed = 1.0;
+    std::stringstream ssSpeed;
+    ssSpeed << "ns3::UniformRandomVariable[Min=" << nodeMinSpeed << "|Max=" << nodeMaxSpeed << "]";
+
+    // Pause refers to the time a node waits before changing direction
+    // (Node remains static while this time passes)
+    std::stringstream ssPause;
+    double nodePause = 0.0;
+    ssPause << "ns3::ConstantRandomVariable[Constant=" << nodePause << "]";
+
+    // Configure mobility model
+
+    // Firstly, get speed and pause as strings:
+    std::string sSpeed = ssSpeed.str();
+    std::string sPause = ssPause.str();
+
+    //
+    // Configure network stack
+    //
+
+    // Enable OLSR
+    OlsrHelper olsr;
+
+    // Or static routes, filled once the whole hierarchy is built
+    // (they go to the trie when there is one, static routing stays for anything else)
+    Ipv4StaticRoutingHelper staticRouting;
+    TrieRoutingHelper trieRouting;
+    Ipv4ListRoutingHelper staticList;
+    staticList.Add(staticRouting, 0);
+    if (routeLookup == "trie")
+        staticList.Add(trieRouting, 10);
+
+    // Multi-head clusters add gateway selection on members, over OLSR (see below)
+    Ipv4ListRoutingHelper olsrList;
+    olsrList.Add(olsr, 10);
+
+    // Install network stack
+    InternetStackHelper internet;
+
+    // Gateways of each cluster into the level above, first level first
+    std::vector<int> nGateways = {gateways1, gateways2, gateways3};
+    nGateways.resize(std::max(nLevels - 1, 0));
+    for (int l = 0; l < (int)nGateways.size(); l++)
+    {
+        NS_ABORT_MSG_IF(nGateways[l] < 1, "Clusters need at least one gateway");
+        NS_ABORT_MSG_IF(nGateways[l] > 1 && routingMode != "olsr", "Multi-head clusters need OLSR routing");
+        NS_ABORT_MSG_IF(nGateways[l] > 1 && headRotationInterval > 0, "Multi-head clusters can't rotate heads");
+    }
+    NS_ABORT_MSG_IF(gatewaySelection != "hash" && gatewaySelection != "leastLoad",
+                    "Unknown gateway selection " << gatewaySelection);
+
+    if (routingMode == "hierarchical")
+        internet.SetRoutingHelper(staticList);
+    else if (!nGateways.empty() && nGateways[0] > 1)
+        internet.SetRoutingHelper(olsrList);
+    else
+        internet.SetRoutingHelper(olsr); // has effect on the next Install ()
+
+    // Assign IPv4 addresses (First layer)
+    Ipv4AddressHelper ipAddrs1stLayer;
+    ipAddrs1stLayer.SetBase("10.0.0.0", "255.255.255.0");
+
+    // Assign IPv4 addresses (Second layer)
+    Ipv4AddressHelper ipAddrs2ndLayer;
+    ipAddrs2ndLayer.SetBase("192.168.0.0", "255.255.255.0");
+
+    // Assign IPv4 addresses (Third layer)
+    Ipv4AddressHelper ipAddrs3rdLayer;
+    ipAddrs3rdLayer.SetBase("172.16.0.0", "255.255.255.0");
+
+    // Assign IPv4 addresses (Fourth layer)
+    Ipv4AddressHelper ipAddrs4thLayer;
+    ipAddrs4thLayer.SetBase("172.17.0.0", "255.255.255.0");
+
+    // Heads rotating among the nodes with most resources need those nodes ready to take
+    // over: an AP device on their cluster and a device on second level, asleep while
+    // they aren't heads (see HeadRotation)
+    int nCandidates = 1;
+    if (headRotationInterval > 0)
+    {
+        NS_ABORT_MSG_IF(routingMode != "olsr", "Head rotation needs OLSR routing");
+        NS_ABORT_MSG_IF(nLevels < 2 || backbones()[1].wired(), "Head rotation needs a wifi second level");
+        NS_ABORT_MSG_IF(admission != "off", "Admission budgets stay on the first heads, they can't rotate");
+        nCandidates = std::max(1, std::min(headCandidates, nNodes_pC_1st_level));
+    }
+
+    // Hierarchical plan replaces the bases above with networks derived from the tree
+    HierarchicalAddressAllocator addressAllocator;
+    if (addressPlan == "hierarchical")
+    {
+        std::vector<int> fanOuts = {nNodes_pC_1st_level, nNodes_pC_2nd_level, nNodes_pC_3rd_level, nClusters_3rd_level};
+        fanOuts.resize(nLevels);
+
+        // Head candidates add an AP device on their cluster and a device on second level,
+        // extra gateways a device on the level above
+        std::vector<int> devices = fanOuts;
+        devices[0] += nCandidates > 1 ? nCandidates : 0;
+        if (nLevels > 1)
+            devices[1] *= nCandidates;
+        for (int l = 0; l < (int)nGateways.size(); l++)
+            devices[l + 1] *= nGateways[l];
+
+        addressAllocator.configure(fanOuts, devices);
+    }
+
+    // PHY settings of each level
+    std::vector<PhyProfile> levelProfiles = phyProfiles();
+
+    // Medium of each level, point to point links take networks from 172.28.0.0/15 (past
+    // every level block, see HierarchicalAddressAllocator)
+    std::vector<BackboneProfile> levelBackbones = backbones();
+    Ipv4AddressHelper backboneLinks;
+    backboneLinks.SetBase("172.28.0.0", "255.255.255.252");
+
+    // Ad hoc networks between members and gateways of multi-head clusters, from 172.30.0.0/15
+    Ipv4AddressHelper gatewayLinks;
+    gatewayLinks.SetBase("172.30.0.0", "255.255.255.0");
+
+    // Mobility helper
+    MobilityHelper mobilityAdhoc;
+
+    // We are now able to create nodes
+
+    // Initialize all levels
+    Level first_level, second_level, third_level, fourth_level;
+
+    // With shared spectrum heads are placed before creating clusters, so channels can be
+    // planned from their positions (heads keep moving afterwards, the plan doesn't)
+    std::vector<Vector> headPositions;
+    std::vector<uint32_t> clusterChannels;
+    std::vector<Ptr<YansWifiChannel>> sharedChannels;
+    if (channelPlan != "private")
+    {
+        Ptr<UniformRandomVariable> coordinate = CreateObject<UniformRandomVariable>();
+        for (int i = 0; i < nClusters_1st_level; i++)
+        {
+            double x = coordinate->GetValue(0, width);
+            headPositions.push_back(Vector(x, coordinate->GetValue(0, height), 0));
+        }
+
+        clusterChannels = ChannelPlanner::plan(headPositions, interferenceRange, nChannels, channelPlan);
+        for (int c = 0; c < nChannels; c++)
+            sharedChannels.push_back(channel.Create());
+
+        if (verbose)
+            std::cout << "Channel plan (" << channelPlan << "): "
+                      << ChannelPlanner::conflicts(headPositions, interferenceRange, clusterChannels)
+                      << " neighbour clusters sharing a channel" << std::endl;
+    }
+
+    if (verbose)
+        std::cout << "Creating first level clusters..." << std::endl;
+
+    // Always create nodes for the first level (note actually all nodes instances will be created here)
+    // Create nodes for each cluster in first level
+    for (int i = 0; i < nClusters_1st_level; i++)
+    {
+        if (verbose)
+            std::cout << "[Lvl 1] Creating cluster #" << i << std::endl;
+        //  Create cluster
+        Cluster cluster(i);
+
+        // Since we are in the first layer, create nodes
+        cluster.generateNodes(nNodes_pC_1st_level);
+
+        // Group nodes by defining head
+        cluster.separateHead(0); // Note node #0 is the one with highest resources
+
+        // Next ones in resources take over when heads rotate
+        for (int c = 0; c < nCandidates; c++)
+            cluster.headCandidates.Add(cluster.ns3Nodes.Get(c));
+
+        // Head represents this cluster on second level
+        cluster.gateway = cluster.headContainer.Get(0);
+
+        // Along with next nodes in resources when clusters are multi-head
+        int nClusterGateways = nGateways.empty() ? 1 : std::min(nGateways[0], nNodes_pC_1st_level);
+        for (int g = 0; g < nClusterGateways; g++)
+            cluster.gateways.Add(cluster.ns3Nodes.Get(g));
+
+        // Physical layer
+        WifiHelper nodesWifi;
+
+        // phy.Set("ChannelNumber", UintegerValue(1));
+        phy.SetChannel(channelPlan == "private" ? channel.Create() : sharedChannels[clusterChannels[i]]);
+        YansWifiPhyHelper levelPhy = levelProfiles[0].configure(nodesWifi, phy);
+
+        // Data link layer
+        WifiMacHelper nodesMac;
+
+        // Each subnetwork (cluster) will be identified by a different SSID
+        std::string ssidString("wifi-cluster-");
+        std::stringstream ss;
+        ss << i; // Each SSID has the format: wifi-cluster-i
+        ssidString += ss.str();
+
+        Ssid ssid = Ssid(ssidString);
+
+        nodesMac.SetType("ns3::StaWifiMac",
+                         "Ssid", SsidValue(ssid),
+                         "QosSupported", BooleanValue(levelProfiles[0].qosSupported()));
+
+        // Nodes will connect to their cluster head (which is actually an AP on this case)
+        // When heads rotate, every node has a station (its first interface, so addresses
+        // of flows don't change with the head)
+        NetDeviceContainer ns3DevicesExcludingHead = nodesWifi.Install(
+            levelPhy, nodesMac, nCandidates > 1 ? cluster.ns3Nodes : cluster.ns3NodesExcludingHead);
+
+        // Setup heads as APs
+        nodesMac.SetType("ns3::ApWifiMac",
+                         "Ssid", SsidValue(ssid),
+                         "QosSupported", BooleanValue(levelProfiles[0].qosSupported()));
+
+        NetDeviceContainer headDevice = nodesWifi.Install(levelPhy, nodesMac, cluster.headCandidates);
+
+        // Total cluster devices
+        cluster.ns3Devices.Add(headDevice);
+        cluster.ns3Devices.Add(ns3DevicesExcludingHead);
+        levelProfiles[0].configureMac(cluster.ns3Devices);
+
+        // All nodes are including in OLSR protocol
+        internet.Install(cluster.ns3Nodes);
+
+        // Network depends on cluster position when using hierarchical plan
+        if (addressPlan == "hierarchical")
+            addressAllocator.setBase(ipAddrs1stLayer, 0, i);
+
+        // It is kinda useful to save interfaces for future connections
+        Ipv4InterfaceContainer assignedAddresses = ipAddrs1stLayer.Assign(
+            cluster.ns3Devices);
+
+        // Step next subnet
+        ipAddrs1stLayer.NewNetwork();
+
+        // Members of multi-head clusters reach gateways directly, through an ad hoc device
+        // on the cluster channel (relayed by the AP, offloaded packets would take two
+        // transmissions and still load the head). It's the second interface of every node
+        if (nClusterGateways > 1)
+        {
+            nodesMac.SetType("ns3::AdhocWifiMac",
+                             "QosSupported", BooleanValue(levelProfiles[0].qosSupported()));
+
+            NetDeviceContainer gatewayDevices = nodesWifi.Install(levelPhy, nodesMac, cluster.ns3Nodes);
+            levelProfiles[0].configureMac(gatewayDevices);
+            gatewayLinks.Assign(gatewayDevices);
+            gatewayLinks.NewNetwork();
+
+            // Monitors count their airtime and drops with the rest of the cluster
+            cluster.ns3Devices.Add(gatewayDevices);
+        }
+
+        // Create nodes
+        cluster.createClusterNodes(
+            trafficRatio,
+            firstLayerResources[i],
+            probability);
+        if (verbose)
+            std::cout << "Resources in this cluster: " << cluster.getResources() << std::endl;
+
+        // Add this cluster to first level clusters
+        first_level.clusters.push_back(cluster);
+
+        // Mobility will be set later after configuring heads mobility
+    }
+    if (verbose)
+        std::cout << "[Lvl 1] Finished clusters creation..." << std::endl;
+
+    if (verbose)
+        std::cout << "Creating second level clusters..." << std::endl;
+
+    // Get nodes for second cluster (Heads on first level)
+    for (int i = 0; i < nClusters_2nd_level; i++)
+    {
+        // std::cout << "[Lvl 2] Creating cluster #" << i << std::endl;
+        //  Create cluster
+        Cluster cluster(i + nClusters_1st_level);
+
+        // Heads make up the cluster, other candidates and gateways only get a device
+        NodeContainer nodes, extraNodes;
+
+        // Get nodes for this cluster, they were created in previous step
+        for (int j = 0; j < nNodes_pC_2nd_level; j++)
+        {
+            int child = i * nNodes_pC_2nd_level + j;
+
+            // Add head as an element from cluster
+            nodes.Add(first_level.clusters[child].headContainer.Get(0));
+
+            for (uint32_t c = 1; c < first_level.clusters[child].headCandidates.GetN(); c++)
+                extraNodes.Add(first_level.clusters[child].headCandidates.Get(c));
+            for (uint32_t g = 1; g < first_level.clusters[child].gateways.GetN(); g++)
+                extraNodes.Add(first_level.clusters[child].gateways.Get(g));
+
+            // Save tree structure
+            cluster.children.push_back(child);
+            first_level.clusters[child].parent = i;
+        }
+
+        // Set nodes in cluster
+        cluster.setNodes(nodes);
+
+        // Wired backbones take the place of wifi
+        if (levelBackbones[1].wired())
+            cluster.ns3Devices = levelBackbones[1].install(NodeContainer(cluster.ns3Nodes, extraNodes), backboneLinks);
+        else
+        {
+            // Physical layer
+            WifiHelper nodesWifi;
+
+            phy.SetChannel(channel.Create());
+            YansWifiPhyHelper levelPhy = levelProfiles[1].configure(nodesWifi, phy);
+
+            //
+            // Configure data link layer
+            //
+            WifiMacHelper nodesMac;
+            nodesMac.SetType("ns3::AdhocWifiMac",
+                             "QosSupported", BooleanValue(levelProfiles[1].qosSupported()));
+
+            // Create physical interfaces between 2nd layer nodes
+            cluster.ns3Devices = nodesWifi.Install(
+                levelPhy, nodesMac, cluster.ns3Nodes);
+            cluster.ns3Devices.Add(nodesWifi.Install(levelPhy, nodesMac, extraNodes));
+            levelProfiles[1].configureMac(cluster.ns3Devices);
+        }
+
+        if (addressPlan == "hierarchical")
+            addressAllocator.setBase(ipAddrs2ndLayer, 1, i);
+
+        // Note internet stack is already installed on nodes
+        // (point to point links got their own networks when created)
+        if (!levelBackbones[1].pointToPoint())
+            ipAddrs2ndLayer.Assign(cluster.ns3Devices);
+        levelBackbones[1].configureQueues(cluster.ns3Devices);
+
+        // Create position allocator, random at start
         ObjectFactory pos;
         pos.SetTypeId("ns3::RandomRectanglePositionAllocator");
 
-        // Define boundaries for our area (By default 500x500), units are meters
-        std::stringstream ssMaxX;
-        ssMaxX << "ns3::UniformRandomVariable[Min=0.0|Max=" << width << "]";
-        pos.Set("X", StringValue(ssMaxX.str()));
+        // Define boundaries for our area (By default 500x500), units are meters
+        std::stringstream ssMaxX;
+        ssMaxX << "ns3::UniformRandomVariable[Min=0.0|Max=" << width << "]";
+        pos.Set("X", StringValue(ssMaxX.str()));
+
+        std::stringstream ssMaxY;
+        ssMaxY << "ns3::UniformRandomVariable[Min=0.0|Max=" << height << "]";
+        pos.Set("Y", StringValue(ssMaxY.str()));
+
+        // Create position allocators based on geometrical boundaries already defined
+        // int64_t streamIndex = 0; // used to get consistent mobility across scenarios
+        Ptr<PositionAllocator> taPositionAlloc = pos.Create()->GetObject<PositionAllocator>();
+
+        // Set random way mobility on head nodes
+        mobilityAdhoc.SetMobilityModel("ns3::RandomWaypointMobilityModel",
+                                       "Speed", StringValue(sSpeed),
+                                       "Pause", StringValue(sPause),
+                                       "PositionAllocator", PointerValue(taPositionAlloc));
+        mobilityAdhoc.SetPositionAllocator(taPositionAlloc);
+
+        // Heads start where channels were planned for
+        if (channelPlan != "private")
+        {
+            Ptr<ListPositionAllocator> plannedPositions = CreateObject<ListPositionAllocator>();
+            for (int child : cluster.children)
+                plannedPositions->Add(headPositions[child]);
+            mobilityAdhoc.SetPositionAllocator(plannedPositions);
+        }
+
+        // Remind that on fitst layer we didn't configured mobility for heads
+        mobilityAdhoc.Install(cluster.ns3Nodes);
+
+        // Step next subnet
+        ipAddrs2ndLayer.NewNetwork();
+
+        // Add this cluster to second level clusters
+        second_level.clusters.push_back(cluster);
+    }
+
+    if (verbose)
+        std::cout << "[Lvl 2] Finished clusters creation..." << std::endl;
+
+    // Now set mobility for lvl 1 nodes
+    if (verbose)
+        std::cout << "[Lvl 1] Placing mobility models..." << std::endl;
+
+    for (int i = 0; i < nClusters_1st_level; i++)
+    {
+        Cluster cluster = first_level.clusters[i];
+
+        // Configure mobility model, nodes will follow head within a certain rectangle movement
+        // We consider cleaner to use a simplier model for internal nodes movement within a head
+        // also its even easier to manage movement bounds
+        Ptr<ListPositionAllocator> subnetAlloc =
+            CreateObject<ListPositionAllocator>();
+        for (uint8_t j = 0; j < nNodes_pC_1st_level; j++)
+        {
+            subnetAlloc->Add(Vector(0.0, j, 0.0));
+        }
+
+        // Nodes move around cluster's head
+        mobilityAdhoc.PushReferenceMobilityModel(cluster.headContainer.Get(0));
+        mobilityAdhoc.SetPositionAllocator(subnetAlloc);
+        mobilityAdhoc.SetMobilityModel("ns3::RandomDirection2dMobilityModel",
+                                       "Bounds", RectangleValue(Rectangle(-10, 10, -10, 10)),
+                                       "Speed", StringValue(sSpeed),
+                                       "Pause", StringValue(sPause));
+        mobilityAdhoc.Install(cluster.ns3Nodes);
+    }
+
+    // Config third layer only if needed
+    if (nLevels > 2)
+    {
+        if (verbose)
+            std::cout << "Creating third level clusters..." << std::endl;
+
+        for (int i = 0; i < nClusters_3rd_level; i++)
+        {
+            if (verbose)
+                std::cout << "[Lvl 3] Creating cluster #" << i << std::endl;
+
+            // Create cluster
+            Cluster cluster(i + nClusters_1st_level + nClusters_2nd_level);
+
+            NodeContainer nodes, extraNodes;
+
+            // Get nodes for this cluster, they were created in previous step
+            for (int j = 0; j < nNodes_pC_3rd_level; j++)
+            {
+                int child = i * nNodes_pC_3rd_level + j;
+
+                // Second level cluster is represented by a node of its first subcluster
+                // (which is connected to second level through the head), further gateways
+                // take the same node of next subclusters, then the next node of each
+                int nClusterGateways = std::min(nGateways[1], nNodes_pC_2nd_level * (nNodes_pC_1st_level - 1));
+                for (int g = 0; g < nClusterGateways; g++)
+                    second_level.clusters[child].gateways.Add(
+                        first_level.clusters[child * nNodes_pC_2nd_level + g % nNodes_pC_2nd_level]
+                            .ns3Nodes.Get(1 + g / nNodes_pC_2nd_level));
+                Ptr<Node> gateway = second_level.clusters[child].gateways.Get(0);
+
+                // Add head as an element for cluster
+                nodes.Add(gateway);
+                for (int g = 1; g < nClusterGateways; g++)
+                    extraNodes.Add(second_level.clusters[child].gateways.Get(g));
+
+                // Save tree structure
+                cluster.children.push_back(child);
+                second_level.clusters[child].parent = i;
+                second_level.clusters[child].gateway = gateway;
+            }
+
+            // Set nodes in cluster
+            cluster.setNodes(nodes);
+
+            // Wired backbones take the place of wifi
+            if (levelBackbones[2].wired())
+                cluster.ns3Devices = levelBackbones[2].install(NodeContainer(cluster.ns3Nodes, extraNodes), backboneLinks);
+            else
+            {
+                // Physical layer
+                WifiHelper nodesWifi;
+
+                phy.SetChannel(channel.Create());
+                YansWifiPhyHelper levelPhy = levelProfiles[2].configure(nodesWifi, phy);
+
+                //
+                // Configure data link layer
+                //
+                WifiMacHelper nodesMac;
+                nodesMac.SetType("ns3::AdhocWifiMac",
+                                 "QosSupported", BooleanValue(levelProfiles[2].qosSupported()));
+
+                // Create physical interfaces between 2nd layer nodes
+                cluster.ns3Devices = nodesWifi.Install(
+                    levelPhy, nodesMac, cluster.ns3Nodes);
+                cluster.ns3Devices.Add(nodesWifi.Install(levelPhy, nodesMac, extraNodes));
+                levelProfiles[2].configureMac(cluster.ns3Devices);
+            }
+
+            if (addressPlan == "hierarchical")
+                addressAllocator.setBase(ipAddrs3rdLayer, 2, i);
+
+            // Note internet stack is already installed on nodes
+            // (point to point links got their own networks when created)
+            if (!levelBackbones[2].pointToPoint())
+                ipAddrs3rdLayer.Assign(cluster.ns3Devices);
+            levelBackbones[2].configureQueues(cluster.ns3Devices);
+
+            // Mobility model is already setted for heads
+
+            // Step next subnet
+            ipAddrs3rdLayer.NewNetwork();
+
+            // Add this cluster to second level clusters
+            third_level.clusters.push_back(cluster);
+        }
+
+        if (verbose)
+            std::cout << "[Lvl 3] Finished clusters creation..." << std::endl;
+
+        if (nLevels > 3)
+        {
+            // Finally, there is a maximum of four levels in case third layer
+            // has multiple clusters
+
+            if (verbose)
+                std::cout << "Creating fourth level cluster..." << std::endl;
+
+            if (verbose)
+                std::cout << "[Lvl 4] Creating cluster #0" << std::endl;
+
+            // Create cluster
+            Cluster cluster(nClusters_1st_level + nClusters_2nd_level + nClusters_3rd_level);
+
+            NodeContainer nodes, extraNodes;
+
+            // Get nodes for this cluster, they were created in previous steps
+            // (third node of first level subclusters, like second level gateways)
+            int nSubclusters = nNodes_pC_2nd_level * nNodes_pC_3rd_level;
+            int nClusterGateways = std::min(nGateways[2], nSubclusters * (nNodes_pC_1st_level - 2));
+            for (int j = 0; j < nClusters_3rd_level; j++)
+            {
+                for (int g = 0; g < nClusterGateways; g++)
+                    third_level.clusters[j].gateways.Add(
+                        first_level.clusters[j * nSubclusters + g % nSubclusters].ns3Nodes.Get(2 + g / nSubclusters));
+                Ptr<Node> gateway = third_level.clusters[j].gateways.Get(0);
+
+                // Add head as an element for cluster
+                nodes.Add(gateway);
+                for (int g = 1; g < nClusterGateways; g++)
+                    extraNodes.Add(third_level.clusters[j].gateways.Get(g));
+
+                // Save tree structure
+                cluster.children.push_back(j);
+                third_level.clusters[j].parent = 0;
+                third_level.clusters[j].gateway = gateway;
+            }
+
+            // Set nodes in cluster
+            cluster.setNodes(nodes);
+
+            // Wired backbones take the place of wifi
+            if (levelBackbones[3].wired())
+                cluster.ns3Devices = levelBackbones[3].install(NodeContainer(cluster.ns3Nodes, extraNodes), backboneLinks);
+            else
+            {
+                // Physical layer
+                WifiHelper nodesWifi;
+
+                phy.SetChannel(channel.Create());
+                YansWifiPhyHelper levelPhy = levelProfiles[3].configure(nodesWifi, phy);
+
+                //
+                // Configure data link layer
+                //
+                WifiMacHelper nodesMac;
+                nodesMac.SetType("ns3::AdhocWifiMac",
+                                 "QosSupported", BooleanValue(levelProfiles[3].qosSupported()));
+
+                // Create physical interfaces between 2nd layer nodes
+                cluster.ns3Devices = nodesWifi.Install(
+                    levelPhy, nodesMac, cluster.ns3Nodes);
+                cluster.ns3Devices.Add(nodesWifi.Install(levelPhy, nodesMac, extraNodes));
+                levelProfiles[3].configureMac(cluster.ns3Devices);
+            }
+
+            if (addressPlan == "hierarchical")
+                addressAllocator.setBase(ipAddrs4thLayer, 3, 0);
+
+            // Note internet stack is already installed on nodes
+            // (point to point links got their own networks when created)
+            if (!levelBackbones[3].pointToPoint())
+                ipAddrs4thLayer.Assign(cluster.ns3Devices);
+            levelBackbones[3].configureQueues(cluster.ns3Devices);
+
+            // Mobility model is already setted for heads
+
+            // Add this cluster to second level clusters
+            fourth_level.clusters.push_back(cluster);
+
+            if (verbose)
+                std::cout << "[Lvl 4] Finished clusters creation..." << std::endl;
+        }
+    }
+
+    // Levels actually used, first level goes first
+    std::vector<Level *> hierarchy = {&first_level, &second_level, &third_level, &fourth_level};
+    hierarchy.resize(nLevels);
+
+    // Needs to live while simulation runs (routes may change with mobility)
+    HierarchicalRouting hierarchicalRouting;
+
+    if (routingMode == "hierarchical")
+    {
+        if (verbose)
+            std::cout << "Calculating hierarchical routes..." << std::endl;
+
+        // First level subtrees are their own network
+        for (Cluster &cluster : first_level.clusters)
+        {
+            Ptr<Ipv4> ipv4 = cluster.gateway->GetObject<Ipv4>();
+            Ipv4InterfaceAddress ifAddr = ipv4->GetAddress(ipv4->GetInterfaceForDevice(cluster.ns3Devices.Get(0)), 0);
+
+            cluster.prefixes.push_back(std::make_pair(ifAddr.GetLocal().CombineMask(ifAddr.GetMask()), ifAddr.GetMask()));
+        }
+
+        // Further levels reach every network of their children
+        // (a single prefix when using the hierarchical address plan)
+        for (int l = 1; l < nLevels; l++)
+        {
+            for (uint32_t i = 0; i < hierarchy[l]->clusters.size(); i++)
+            {
+                Cluster &cluster = hierarchy[l]->clusters[i];
+
+                if (addressPlan == "hierarchical")
+                {
+                    cluster.prefixes.push_back(addressAllocator.subtreePrefix(l, i));
+                    continue;
+                }
+
+                for (int child : cluster.children)
+                {
+                    std::vector<std::pair<Ipv4Address, Ipv4Mask>> &childPrefixes = hierarchy[l - 1]->clusters[child].prefixes;
+                    cluster.prefixes.insert(cluster.prefixes.end(), childPrefixes.begin(), childPrefixes.end());
+                }
+            }
+        }
+
+        for (uint32_t l = 0; l < hierarchy.size(); l++)
+            hierarchicalRouting.wiredLevels.push_back(levelBackbones[l].wired());
+        hierarchicalRouting.build(hierarchy, routingRange);
+
+        if (verbose)
+            std::cout << "Installed routes: " << hierarchicalRouting.nRoutes << std::endl;
+    }
+
+    // Members of multi-head first level clusters pick the gateway of their inter-cluster
+    // packets (upper levels are left to OLSR, which sees every gateway as a route)
+    std::vector<std::shared_ptr<GatewayGroup>> gatewayGroups;
+    for (Cluster &cluster : first_level.clusters)
+    {
+        if (cluster.gateways.GetN() < 2)
+            continue;
+
+        std::shared_ptr<GatewayGroup> group = std::make_shared<GatewayGroup>();
+        NetDeviceContainer uplinks = second_level.clusters[cluster.parent].ns3Devices;
+        for (uint32_t g = 0; g < cluster.gateways.GetN(); g++)
+        {
+            Ptr<Node> gateway = cluster.gateways.Get(g);
+            group->addresses.push_back(gateway->GetObject<Ipv4>()->GetAddress(2, 0).GetLocal());
+
+            for (uint32_t d = 0; d < uplinks.GetN(); d++)
+            {
+                if (uplinks.Get(d)->GetNode() == gateway)
+                {
+                    group->uplinks.push_back(uplinks.Get(d));
+                    break;
+                }
+            }
+        }
+        group->destinations.resize(group->addresses.size(), 0);
+        group->packets.resize(group->addresses.size(), 0);
+
+        // Members with an upper level device of their own (higher gateways) route by themselves
+        // (others have loopback, station and ad hoc devices)
+        for (uint32_t n = cluster.gateways.GetN(); n < cluster.ns3Nodes.GetN(); n++)
+        {
+            if (cluster.ns3Nodes.Get(n)->GetNDevices() > 3)
+                continue;
+
+            Ptr<GatewaySelectionRouting> selection = CreateObject<GatewaySelectionRouting>();
+            selection->group = group;
+            selection->policy = gatewaySelection;
+
+            Ptr<Ipv4ListRouting> list = DynamicCast<Ipv4ListRouting>(cluster.ns3Nodes.Get(n)->GetObject<Ipv4>()->GetRoutingProtocol());
+            list->AddRoutingProtocol(selection, 20);
+        }
+
+        gatewayGroups.push_back(group);
+    }
+
+    // Count OLSR control traffic (needs to live while simulation runs)
+    OlsrOverheadTracker olsrOverhead;
+    if (routingMode == "olsr")
+        olsrOverhead.install(hierarchy);
+
+    // Preparate nodes for simulation
+    if (verbose)
+        std::cout << "Preparing random traffic for simulation..." << std::endl;
+
+    // Captured traffic replaces flows when given
+    std::shared_ptr<TraceReplay> traceReplay;
+    if (!traceFile.empty())
+    {
+        traceReplay = std::make_shared<TraceReplay>(traceFile, traceReadAhead, first_level, this);
+        traceReplay->start();
+    }
+
+    // Flows between nodes in first level, from a file or a model
+    TrafficMatrix trafficMatrix;
+    if (traceReplay)
+    {
+        // No flows
+    }
+    else if (!trafficFile.empty())
+        trafficMatrix.load(trafficFile, first_level);
+    else
+        trafficMatrix.generate(trafficModel, nFlows, first_level, intraClusterFraction, hotspotFraction, std::rand());
+
+    // Flows of the same sender end up together
+    trafficMatrix.sortBySender(first_level);
+
+    for (TrafficFlow &flow : trafficMatrix.flows)
+    {
+        // Nodes are taken by reference, since they keep callbacks
+        ClusterNode &senderNode = first_level.clusters[flow.srcCluster].nodes[flow.srcNode];
+        ClusterNode &receiverNode = first_level.clusters[flow.dstCluster].nodes[flow.dstNode];
+
+        // Printing every connection is too much on big matrices
+        if (verbose && trafficMatrix.flows.size() <= 100)
+            std::cout << "Connecting IP Address: "
+                      << senderNode.node->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal()
+                      << " with IP Address: "
+                      << receiverNode.node->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal()
+                      << std::endl;
+
+        std::string flowClass = flow.srcCluster == flow.dstCluster ? intraClusterClass : interClusterClass;
+        senderNode.connectWithNode(receiverNode, this, FlowClassTag::fromName(flowClass));
+    }
+
+    if (verbose)
+        std::cout << "Flows: " << trafficMatrix.flows.size() << std::endl;
+
+    if (verbose)
+        std::cout << "Running simulation..." << std::endl;
+
+    // Run simulation
+    Simulator::Stop(Seconds(simulationTime));
+
+    // Heads enforce resources of their members (before DropTracker looks for queue discs)
+    std::vector<std::shared_ptr<AdmissionBudget>> admissionBudgets;
+    if (admission != "off")
+        admissionBudgets = HeadAdmissionQueueDisc::install(first_level, admission, admissionBurst, admissionHeadroom);
+
+    // Where packets get lost
+    DropTracker dropTracker;
+    dropTracker.install(hierarchy);
+
+    // Class packets must reach the queue of their access category on QoS devices
+    std::set<Ptr<NetDevice>> classDevices;
+    for (Level *level : hierarchy)
+    {
+        for (Cluster &cluster : level->clusters)
+        {
+            for (uint32_t d = 0; d < cluster.ns3Devices.GetN(); d++)
+            {
+                Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice>(cluster.ns3Devices.Get(d));
+                if (!device || !classDevices.insert(device).second)
+                    continue;
+
+                std::vector<Ptr<WifiMacQueue>> queues = DeviceQueues(device);
+                for (uint8_t c = 0; queues.size() == FlowClassTag::N_CLASSES && c < FlowClassTag::N_CLASSES; c++)
+                    queues[c]->TraceConnectWithoutContext("Enqueue", MakeBoundCallback(&ClassQueued, this, c));
+            }
+        }
+    }
+
+    // Airtime of every channel
+    ChannelMonitor channelMonitor;
+    channelMonitor.install(hierarchy);
+
+    // Load on heads
+    HeadMonitor headMonitor;
+    if (headReport > 0)
+        headMonitor.install(hierarchy, headSampleInterval, simulationTime);
+
+    // Hopeless (or already good enough) runs end early
+    EarlyStopMonitor earlyStop;
+    earlyStop.start(this);
+
+    // Heads handing over to less loaded candidates
+    HeadRotation headRotation;
+    if (nCandidates > 1)
+        headRotation.install(first_level, second_level, headRotationInterval, headRotationHysteresis, simulationTime);
+
+    // Throughput once the network settled is taken over the second half
+    Simulator::Schedule(Seconds(simulationTime / 2), &Taller1Experiment::markHalfTime, this);
+
+    // Level metrics along the run
+    std::unique_ptr<TimeSeriesCollector> timeSeries;
+    if (!timeSeriesFile.empty())
+    {
+        timeSeries.reset(new TimeSeriesCollector(timeSeriesFile, timeSeriesInterval, timeSeriesBuffer));
+        timeSeries->install(hierarchy, this);
+    }
+
+    Simulator::Run();
+
+    if (timeSeries)
+        timeSeries->finish();
+
+    std::cout << "Simulation finished" << std::endl;
+    double firstLevelResources = first_level.getResources();
+    std::cout << "Level of resources in first layer: " << firstLevelResources << std::endl;
+
+    // Show performance results
+    std::cout << "Total packets received: " << receivedCount << std::endl;
+    std::cout << "Total packets sent: " << sentCount << std::endl;
+    double throughput = receivedCount / Simulator::Now().GetSeconds(); // Pkt / s
+    double lossRate = (sentCount - receivedCount) / (double)sentCount;
+
+    // Generate simulation results data container
+    SimulationResult results;
+    results.throughput = throughput;
+    results.lossRate = lossRate;
+    results.stats["resources.lvl1"] = firstLevelResources;
+    results.deliveryRatio = sentCount > 0 ? receivedCount / (double)sentCount : 0;
+    results.eventCount = Simulator::GetEventCount();
+    results.memoryKb = GetPeakMemoryKb();
+
+    results.stats["data.rxBytesPerSecond"] = receivedBytes / Simulator::Now().GetSeconds();
+
+    // Throughput and latency by traffic class (only classes carrying flows)
+    Log2Histogram latencyUs;
+    for (int c = 0; c < FlowClassTag::N_CLASSES; c++)
+    {
+        ClassCounters &counters = flowClasses[c];
+        latencyUs.merge(counters.latencyUs);
+        if (counters.sent == 0)
+            continue;
+
+        std::string prefix = std::string("class.") + FlowClassTag::classNames[c] + ".";
+        results.stats[prefix + "sent"] = counters.sent;
+        results.stats[prefix + "received"] = counters.received;
+        results.stats[prefix + "throughput"] = counters.received / Simulator::Now().GetSeconds();
+        results.stats[prefix + "rxBytesPerSecond"] = counters.bytes / Simulator::Now().GetSeconds();
+        results.stats[prefix + "lossRate"] = (counters.sent - std::min(counters.sent, counters.received)) / (double)counters.sent;
+        results.stats[prefix + "latencyMeanUs"] = counters.latencyUs.mean();
+        results.stats[prefix + "latencyP50Us"] = counters.latencyUs.quantile(0.5);
+        results.stats[prefix + "latencyP95Us"] = counters.latencyUs.quantile(0.95);
+        results.stats[prefix + "latencyP99Us"] = counters.latencyUs.quantile(0.99);
+        results.stats[prefix + "latencyMaxUs"] = counters.latencyUs.max;
+
+        std::cout << "Class " << FlowClassTag::classNames[c] << ": " << counters.received << "/" << counters.sent
+                  << " packets, " << results.stats[prefix + "throughput"] << " Pkt/s, latency mean "
+                  << counters.latencyUs.mean() << " us, p95 " << counters.latencyUs.quantile(0.95) << " us" << std::endl;
+    }
 
-        std::stringstream ssMaxY;
-        ssMaxY << "ns3::UniformRandomVariable[Min=0.0|Max=" << height << "]";
-        pos.Set("Y", StringValue(ssMaxY.str()));
+    // A class sent as another (as a ToS with the wrong user priority would) is a bug
+    for (int c = 0; c < FlowClassTag::N_CLASSES; c++)
+        NS_ABORT_MSG_IF(flowClasses[c].misqueued > 0,
+                        "Packets of class " << FlowClassTag::classNames[c] << " were queued in another access category");
 
-        // Create position allocators based on geometrical boundaries already defined
-        // int64_t streamIndex = 0; // used to get consistent mobility across scenarios
-        Ptr<PositionAllocator> taPositionAlloc = pos.Create()->GetObject<PositionAllocator>();
+    results.stats["data.latencyMeanUs"] = latencyUs.mean();
+    results.stats["data.latencyP95Us"] = latencyUs.quantile(0.95);
+    results.stats["data.latencyP99Us"] = latencyUs.quantile(0.99);
 
-        // Set random way mobility on head nodes
-        mobilityAdhoc.SetMobilityModel("ns3::RandomWaypointMobilityModel",
-                                       "Speed", StringValue(sSpeed),
-                                       "Pause", StringValue(sPause),
-                                       "PositionAllocator", PointerValue(taPositionAlloc));
-        mobilityAdhoc.SetPositionAllocator(taPositionAlloc);
+    // Admission control at first level heads
+    if (!admissionBudgets.empty())
+    {
+        uint64_t admitted = 0, memberDrops = 0, aggregateDrops = 0;
+        for (std::shared_ptr<AdmissionBudget> &budget : admissionBudgets)
+        {
+            admitted += budget->admitted;
+            memberDrops += budget->memberDrops;
+            aggregateDrops += budget->aggregateDrops;
+        }
 
-        // Remind that on fitst layer we didn't configured mobility for heads
-        mobilityAdhoc.Install(cluster.ns3Nodes);
+        results.stats["admission.admitted"] = admitted;
+        results.stats["admission.memberDrops"] = memberDrops;
+        results.stats["admission.aggregateDrops"] = aggregateDrops;
 
-        // Step next subnet
-        ipAddrs2ndLayer.NewNetwork();
+        std::cout << "Admission (" << admission << "): " << admitted << " admitted, " << memberDrops
+                  << " over member budget, " << aggregateDrops << " over cluster budget" << std::endl;
+    }
+
+    channelMonitor.exportTo(results, Simulator::Now().GetSeconds());
+
+    if (channelPlan != "private")
+    {
+        results.stats["channelPlan.channels"] = nChannels;
+        results.stats["channelPlan.conflicts"] = ChannelPlanner::conflicts(headPositions, interferenceRange, clusterChannels);
+    }
+
+    if (headReport > 0)
+        headMonitor.report(results, headReport);
+
+    if (nCandidates > 1)
+    {
+        headRotation.report(results);
+        std::cout << "Head handovers: " << headRotation.nHandovers << std::endl;
+    }
+
+    // Inter-cluster packets sent by members through each first level gateway, over
+    // every cluster, and how evenly they spread (least over most)
+    if (!gatewayGroups.empty())
+    {
+        std::vector<uint64_t> gatewayPackets(gatewayGroups[0]->packets.size(), 0);
+        for (std::shared_ptr<GatewayGroup> group : gatewayGroups)
+        {
+            for (uint32_t g = 0; g < group->packets.size(); g++)
+                gatewayPackets[g] += group->packets[g];
+        }
+
+        std::cout << "Packets per gateway:";
+        for (uint32_t g = 0; g < gatewayPackets.size(); g++)
+        {
+            results.stats["gateways.lvl1.gw" + std::to_string(g) + ".packets"] = gatewayPackets[g];
+            std::cout << " " << gatewayPackets[g];
+        }
+        std::cout << std::endl;
+
+        uint64_t most = *std::max_element(gatewayPackets.begin(), gatewayPackets.end());
+        uint64_t least = *std::min_element(gatewayPackets.begin(), gatewayPackets.end());
+        results.stats["gateways.lvl1.balance"] = most > 0 ? (double)least / most : 1;
+    }
+
+    if (Simulator::Now().GetSeconds() > simulationTime / 2)
+        results.stats["data.secondHalfThroughput"] =
+            (receivedCount - halfTimeReceived) / (Simulator::Now().GetSeconds() - simulationTime / 2);
+
+    // Drops by cause, so we know which layer needs resources
+    dropTracker.exportTo(results);
+    for (int c = 0; c < DropTracker::N_CAUSES; c++)
+        std::cout << "Drops (" << DropTracker::causeNames[c] << "): " << results.stats[std::string("drops.") + DropTracker::causeNames[c]] << std::endl;
+
+    if (earlyStop.outcome >= 0)
+    {
+        std::cout << "Stopped at " << earlyStop.stopTime << " s, targets "
+                  << (earlyStop.outcome ? "met" : "missed") << std::endl;
+
+        results.truncated = true;
+        results.stats["earlyStop.time"] = earlyStop.stopTime;
+        results.stats["earlyStop.outcome"] = earlyStop.outcome;
+    }
+
+    if (traceReplay)
+    {
+        results.stats["trace.replayed"] = traceReplay->nReplayed;
+        results.stats["trace.skipped"] = traceReplay->nSkipped;
+    }
+
+    // Receiving side
+    uint32_t receivedFlows = 0;
+    for (std::pair<const uint32_t, std::shared_ptr<FlowSink>> &sink : sinks)
+        receivedFlows += sink.second->flows.size();
+
+    results.stats["sink.nodes"] = sinks.size();
+    results.stats["sink.flows"] = receivedFlows;
+
+    if (routingMode == "hierarchical")
+    {
+        results.stats["routing.routes"] = hierarchicalRouting.nRoutes;
+        results.stats["routing.recomputations"] = hierarchicalRouting.nRecomputations;
+    }
+
+    if (routingMode == "olsr")
+    {
+        olsrOverhead.exportTo(results, Simulator::Now().GetSeconds());
+
+        // Control against data traffic on each level
+        for (int l = 0; l < nLevels; l++)
+        {
+            std::string prefix = "olsr.lvl" + std::to_string(l + 1) + ".";
+            std::cout << "[Lvl " << l + 1 << "] OLSR control: "
+                      << results.stats[prefix + "txBytesPerSecond"] << " B/s sent, "
+                      << results.stats[prefix + "rxBytesPerSecond"] << " B/s received" << std::endl;
+        }
+        std::cout << "Data received: " << results.stats["data.rxBytesPerSecond"] << " B/s" << std::endl;
+    }
+
+    // Sockets go away with their nodes
+    sinks.clear();
+
+    Simulator::Destroy();
+
+    return results;
+}
+
+// Plan searches from options
+GrowthEstimator::GrowthEstimator(int _argc, char **_argv)
+    : argc(_argc), argv(_argv)
+{
+    std::vector<double> resources(options.nClusters_1st_level);
+    options.HandleCommandLineArgs(argc, argv, resources.data());
+
+    NS_ABORT_MSG_IF(options.growthGridSize < 2 || options.growthMinResources <= 0 ||
+                        options.growthMaxResources <= options.growthMinResources,
+                    "Growth resources grid needs two levels or more between positive bounds");
+    NS_ABORT_MSG_IF(options.growthReplications < 1, "Growth estimation needs a replication at least");
+
+    for (int i = 0; i < options.growthGridSize; i++)
+        grid.push_back(options.growthMinResources *
+                       std::pow(options.growthMaxResources / options.growthMinResources, (double)i / (options.growthGridSize - 1)));
+
+    // Runs are told apart by their seeds only, and reused through the cache
+    if (options.cacheDir.empty())
+        options.cacheDir = "growth-cache";
+    options.seed = SweepSeed(options.seed, options.cacheDir);
+    if (options.lossTarget < 0 && options.throughputTarget <= 0)
+        options.lossTarget = 0.1;
+
+    for (int nLevels : ParseIntList(options.growthLevels))
+    {
+        NS_ABORT_MSG_IF(nLevels < 2 || nLevels > 3, "Growth factors are estimated for 2 and 3 levels");
+
+        for (int nClusters : ParseIntList(options.growthSizes))
+        {
+            NS_ABORT_MSG_IF(nClusters < 1, "Sizes are first level clusters, one at least");
+
+            for (int r = 0; r < options.growthReplications; r++)
+            {
+                Search search;
+                search.nLevels = nLevels;
+                search.nClusters = nClusters;
+                search.replication = r;
+                search.high = grid.size();
+                searches.push_back(search);
+            }
+        }
+    }
+}
+
+// Experiment of a search at a grid level
+Taller1Experiment GrowthEstimator::experiment(const Search &search, int level) const
+{
+    Taller1Experiment experiment;
+    std::vector<double> resources(experiment.nClusters_1st_level);
+    experiment.HandleCommandLineArgs(argc, argv, resources.data());
+
+    experiment.nLevels = search.nLevels;
+    experiment.nClusters_1st_level = search.nClusters;
+
+    // Second level clusters as even as the size allows (fan-out is its least divisor
+    // from the square root on)
+    if (search.nLevels == 3)
+    {
+        int fanOut = std::ceil(std::sqrt((double)search.nClusters));
+        while (search.nClusters % fanOut != 0)
+            fanOut++;
+
+        experiment.nNodes_pC_2nd_level = fanOut;
+        experiment.nClusters_2nd_level = search.nClusters / fanOut;
+    }
+
+    experiment.firstLayerResources.assign(search.nClusters, grid[level]);
+    experiment.seed = options.seed + search.replication;
+    experiment.cacheDir = options.cacheDir;
+    experiment.lossTarget = options.lossTarget;
+
+    return experiment;
+}
+
+// Whether a run met the targets (as decided by EarlyStopMonitor when it stopped the run)
+bool GrowthEstimator::sustained(const SimulationResult &result) const
+{
+    std::map<std::string, double>::const_iterator outcome = result.stats.find("earlyStop.outcome");
+    if (outcome != result.stats.end())
+        return outcome->second == 1;
+
+    return (options.lossTarget < 0 || result.lossRate <= options.lossTarget) &&
+           (options.throughputTarget <= 0 || result.throughput >= options.throughputTarget);
+}
+
+// Run every search to the end, jobs runs at once
+void GrowthEstimator::run()
+{
+    uint32_t nJobs = options.jobs > 0 ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+
+    // Runs are appended in groups, once each. Cache hits missing from resultsFile (still
+    // buffered when an earlier sweep was cut) are saved too
+    ResultStore store(options.resultsFile), details(options.resultsFile + ".details");
+    store.attachDetails(details);
+    std::set<std::string> savedRuns = options.resultsFile.empty() ? std::set<std::string>() : store.runIds();
+
+    // Run going on, with the search and grid level it's for
+    struct Job
+    {
+        uint32_t search;
+        int level;
+        Taller1Experiment experiment;
+        ChildRun child;
+    };
+    std::vector<std::unique_ptr<Job>> running;
+
+    while (true)
+    {
+        // Next level of idle searches, while there is room
+        for (uint32_t s = 0; s < searches.size() && running.size() < nJobs; s++)
+        {
+            Search &search = searches[s];
+            if (search.running || search.low >= search.high)
+                continue;
+
+            std::unique_ptr<Job> job(new Job);
+            job->search = s;
+            job->level = (search.low + search.high) / 2;
+            job->experiment = experiment(search, job->level);
+            job->child = StartChildRun(job->experiment);
+            search.running = true;
+            running.push_back(std::move(job));
+        }
+
+        if (running.empty())
+            break;
+
+        // Wait for some child to write (cached runs are ready already)
+        std::vector<pollfd> fds;
+        bool ready = false;
+        for (std::unique_ptr<Job> &job : running)
+        {
+            fds.push_back({job->child.fd, POLLIN, 0});
+            ready |= job->child.pid < 0;
+        }
+        NS_ABORT_MSG_IF(poll(fds.data(), fds.size(), ready ? 0 : -1) < 0 && errno != EINTR, "Couldn't wait for runs");
+
+        for (uint32_t j = running.size(); j-- > 0;)
+        {
+            Job &job = *running[j];
+            if (job.child.pid >= 0 && (fds[j].revents == 0 || !ReadChildRun(job.child)))
+                continue;
+
+            SimulationResult result = FinishChildRun(job.experiment, job.child);
+            if (result.failed)
+            {
+                // Aborting skips destructors, keep what finished
+                store.flush();
+                details.flush();
+            }
+            NS_ABORT_MSG_IF(result.failed, "Run failed, run again to resume (finished runs are in " << options.cacheDir << ")");
+            if (savedRuns.insert(job.experiment.configKey()).second)
+                job.experiment.saveResult(result, store, details);
+
+            // Bisection, least sustaining level is at high or above low
+            Search &search = searches[job.search];
+            bool sustains = sustained(result);
+            if (sustains)
+                search.high = job.level;
+            else
+                search.low = job.level + 1;
+            search.running = false;
+            search.nRuns++;
+
+            std::cout << search.nLevels << " levels, " << search.nClusters << " clusters, replication "
+                      << search.replication << ": " << grid[job.level] << " per cluster "
+                      << (sustains ? "sustains" : "doesn't sustain") << " targets" << std::endl;
+
+            running.erase(running.begin() + j);
+        }
+    }
+}
+
+// Fit resources found for a level count
+GrowthEstimator::Fit GrowthEstimator::fit(int nLevels) const
+{
+    Fit fit;
+    fit.nLevels = nLevels;
+
+    // Logarithms of first level nodes and total resources of each sustaining search
+    std::vector<double> x, y;
+    for (const Search &search : searches)
+    {
+        if (search.nLevels != nLevels || search.low >= (int)grid.size())
+            continue;
+
+        x.push_back(std::log((double)search.nClusters * options.nNodes_pC_1st_level));
+        y.push_back(std::log(grid[search.low] * search.nClusters));
+    }
+
+    fit.nPoints = x.size();
+    if (fit.nPoints < 3)
+        return fit;
+
+    double meanX = std::accumulate(x.begin(), x.end(), 0.0) / fit.nPoints;
+    double meanY = std::accumulate(y.begin(), y.end(), 0.0) / fit.nPoints;
+    double sxx = 0, sxy = 0, syy = 0;
+    for (int i = 0; i < fit.nPoints; i++)
+    {
+        sxx += (x[i] - meanX) * (x[i] - meanX);
+        sxy += (x[i] - meanX) * (y[i] - meanY);
+        syy += (y[i] - meanY) * (y[i] - meanY);
+    }
+
+    // A single size says nothing about growth
+    if (sxx == 0)
+        return fit;
+
+    double factor = sxy / sxx;
+    double intercept = meanY - factor * meanX;
+    double residual = std::max(syy - factor * sxy, 0.0) / (fit.nPoints - 2);
+    double t = StudentQuantile(1 - (1 - options.growthConfidence) / 2, fit.nPoints - 2);
+
+    fit.factor = factor;
+    fit.factorHalfWidth = t * std::sqrt(residual / sxx);
+    double interceptHalfWidth = t * std::sqrt(residual * (1.0 / fit.nPoints + meanX * meanX / sxx));
+    fit.scale = std::exp(intercept);
+    fit.scaleLow = std::exp(intercept - interceptHalfWidth);
+    fit.scaleHigh = std::exp(intercept + interceptHalfWidth);
+    fit.r2 = syy > 0 ? 1 - (syy - factor * sxy) / syy : 1;
+
+    return fit;
+}
+
+// Fit and print results (and write growthFile)
+void GrowthEstimator::report()
+{
+    std::ofstream file;
+    if (!options.growthFile.empty())
+    {
+        file.open(options.growthFile);
+        NS_ABORT_MSG_IF(!file.is_open(), "Couldn't write " << options.growthFile);
+        file << "nLevels,nClusters,nNodes,replication,clusterResources,totalResources,runs\n";
+    }
+
+    for (int nLevels : ParseIntList(options.growthLevels))
+    {
+        std::cout << nLevels << " levels" << std::endl;
+
+        for (int nClusters : ParseIntList(options.growthSizes))
+        {
+            int nNodes = nClusters * options.nNodes_pC_1st_level;
+
+            // Least sustaining total resources of each replication (missing when none did)
+            std::vector<double> totals;
+            for (const Search &search : searches)
+            {
+                if (search.nLevels != nLevels || search.nClusters != nClusters)
+                    continue;
+
+                bool found = search.low < (int)grid.size();
+                if (found)
+                    totals.push_back(grid[search.low] * nClusters);
+
+                if (file.is_open())
+                {
+                    file << nLevels << "," << nClusters << "," << nNodes << "," << search.replication << ",";
+                    if (found)
+                        file << grid[search.low] << "," << grid[search.low] * nClusters;
+                    else
+                        file << ",";
+                    file << "," << search.nRuns << "\n";
+                }
+            }
+
+            std::cout << "  " << nNodes << " nodes: ";
+            if (totals.empty())
+            {
+                std::cout << "not sustained up to " << grid.back() << " per cluster" << std::endl;
+                continue;
+            }
+
+            double mean = std::accumulate(totals.begin(), totals.end(), 0.0) / totals.size();
+            double halfWidth = 0;
+            if (totals.size() > 1)
+            {
+                double variance = 0;
+                for (double total : totals)
+                    variance += (total - mean) * (total - mean);
+                variance /= totals.size() - 1;
+
+                double t = StudentQuantile(1 - (1 - options.growthConfidence) / 2, totals.size() - 1);
+                halfWidth = t * std::sqrt(variance / totals.size());
+            }
+
+            std::cout << mean << " +- " << halfWidth << " total resources ("
+                      << totals.size() << "/" << options.growthReplications << " sustained)" << std::endl;
+        }
+
+        Fit result = fit(nLevels);
+        if (std::isnan(result.factor))
+        {
+            std::cout << "  Growth factor: not enough sustained sizes to fit (" << result.nPoints << " searches)" << std::endl;
+            continue;
+        }
+
+        std::cout << "  Growth factor: " << result.factor << " +- " << result.factorHalfWidth
+                  << " (" << options.growthConfidence * 100 << "%, " << result.nPoints << " searches, R2 "
+                  << result.r2 << ")" << std::endl;
+        std::cout << "  Resources = " << result.scale << " [" << result.scaleLow << ", " << result.scaleHigh
+                  << "] * N^" << result.factor << std::endl;
+        std::cout << "  Doubling nodes multiplies resources by " << std::pow(2, result.factor) << std::endl;
+    }
+}
+
+// Mbps of a mode named like OfdmRate<rate>Mbps (as in OfdmRate1_5MbpsBW5MHz)
+double ModeRateMbps(std::string mode)
+{
+    size_t begin = mode.find("Rate"), end = mode.find("Mbps");
+    NS_ABORT_MSG_IF(begin == std::string::npos || end == std::string::npos || end <= begin + 4,
+                    "Rate of mode " << mode << " isn't known");
+
+    std::string rate = mode.substr(begin + 4, end - begin - 4);
+    std::replace(rate.begin(), rate.end(), '_', '.');
+
+    return std::stod(rate);
+}
+
+// Random first generation from options
+ParetoExplorer::ParetoExplorer(int _argc, char **_argv)
+    : argc(_argc), argv(_argv)
+{
+    std::vector<double> resources(options.nClusters_1st_level);
+    options.HandleCommandLineArgs(argc, argv, resources.data());
+
+    NS_ABORT_MSG_IF(options.paretoPopulation < 2, "Pareto exploration needs two configurations per generation at least");
+    NS_ABORT_MSG_IF(options.paretoMinResources <= 0 || options.paretoMaxResources < options.paretoMinResources,
+                    "Pareto resources need positive bounds");
+    NS_ABORT_MSG_IF(options.paretoMutation <= 0, "Pareto mutation needs a positive deviation");
+
+    std::stringstream ss(options.paretoRates);
+    std::string rate;
+    while (std::getline(ss, rate, ','))
+    {
+        if (rate.empty())
+            continue;
+
+        rates.push_back(rate);
+        rateCosts.push_back(ModeRateMbps(rate));
+    }
+    NS_ABORT_MSG_IF(rates.empty(), "Pareto exploration needs a second level rate at least");
+
+    // Every configuration runs the same scenario, so they can be compared (and cached)
+    options.seed = SweepSeed(options.seed, options.cacheDir);
+    rng.seed(options.seed);
+
+    std::uniform_real_distribution<double> logResources(std::log(options.paretoMinResources), std::log(options.paretoMaxResources));
+    std::uniform_int_distribution<int> rateIndex(0, rates.size() - 1);
+    for (int i = 0; i < options.paretoPopulation; i++)
+    {
+        Individual individual;
+        for (int c = 0; c < options.nClusters_1st_level; c++)
+            individual.resources.push_back(std::exp(logResources(rng)));
+        individual.rate = rateIndex(rng);
+        population.push_back(individual);
+    }
+}
+
+// Breed every generation
+void ParetoExplorer::run()
+{
+    evaluate(population);
+    sortFronts(population);
+    updateFrontier(population);
+
+    std::cout << "Generation 0: " << frontier.size() << " configurations on the frontier" << std::endl;
+
+    for (int g = 1; g < options.paretoGenerations; g++)
+    {
+        std::vector<Individual> children;
+        while ((int)children.size() < options.paretoPopulation)
+            children.push_back(offspring());
+
+        evaluate(children);
+        updateFrontier(children);
+
+        // Best fronts of parents and children, least crowded first within the last one
+        std::vector<Individual> combined = population;
+        combined.insert(combined.end(), children.begin(), children.end());
+        sortFronts(combined);
+        std::sort(combined.begin(), combined.end(), [](const Individual &a, const Individual &b) {
+            return a.front != b.front ? a.front < b.front : a.crowding > b.crowding;
+        });
+        combined.resize(options.paretoPopulation);
+
+        // Crowding is recalculated among survivors, for next tournaments
+        population = combined;
+        sortFronts(population);
+
+        std::cout << "Generation " << g << ": " << frontier.size() << " configurations on the frontier" << std::endl;
+    }
+}
+
+// Run configurations and take their objectives (failed runs get infinite ones)
+void ParetoExplorer::evaluate(std::vector<Individual> &individuals)
+{
+    std::vector<Taller1Experiment> experiments;
+    for (const Individual &individual : individuals)
+    {
+        Taller1Experiment experiment;
+        std::vector<double> resources(experiment.nClusters_1st_level);
+        experiment.HandleCommandLineArgs(argc, argv, resources.data());
+
+        experiment.firstLayerResources = individual.resources;
+        experiment.secondLayerResources = rates[individual.rate];
+        experiment.seed = options.seed;
+        experiments.push_back(experiment);
+    }
+
+    std::vector<SimulationResult> results = RunInChildProcesses(experiments, options.jobs);
+
+    for (uint32_t i = 0; i < individuals.size(); i++)
+    {
+        Individual &individual = individuals[i];
+        if (results[i].failed)
+        {
+            individual.objectives.assign(4, INFINITY);
+            continue;
+        }
+
+        // Resources actually given to nodes (asked ones on results from older runs)
+        std::map<std::string, double>::const_iterator resources = results[i].stats.find("resources.lvl1");
+        double total = resources != results[i].stats.end()
+                           ? resources->second
+                           : std::accumulate(individual.resources.begin(), individual.resources.end(), 0.0);
+
+        individual.objectives = {total, rateCosts[individual.rate], -results[i].throughput, results[i].lossRate};
+    }
+}
+
+// Child of two tournament winners
+ParetoExplorer::Individual ParetoExplorer::offspring()
+{
+    const Individual &a = tournament();
+    const Individual &b = tournament();
+
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::normal_distribution<double> noise(0, options.paretoMutation);
+
+    // A gene in each of nClusters + 1 mutates on average
+    double mutation = 1.0 / (a.resources.size() + 1);
+
+    Individual child;
+    for (uint32_t c = 0; c < a.resources.size(); c++)
+    {
+        // Blend crossover on logarithms (BLX-0.25, anywhere between parents and a bit beyond)
+        double low = std::log(std::min(a.resources[c], b.resources[c]));
+        double high = std::log(std::max(a.resources[c], b.resources[c]));
+        double margin = (high - low) * 0.25;
+        double value = low - margin + unit(rng) * (high - low + 2 * margin);
+
+        if (unit(rng) < mutation)
+            value += noise(rng);
+
+        child.resources.push_back(std::min(std::max(std::exp(value), options.paretoMinResources), options.paretoMaxResources));
+    }
+
+    child.rate = unit(rng) < 0.5 ? a.rate : b.rate;
+    if (unit(rng) < mutation)
+        child.rate = std::min(std::max(child.rate + (unit(rng) < 0.5 ? -1 : 1), 0), (int)rates.size() - 1);
+
+    return child;
+}
+
+// Better of two random members of population
+const ParetoExplorer::Individual &ParetoExplorer::tournament()
+{
+    std::uniform_int_distribution<uint32_t> pick(0, population.size() - 1);
+    const Individual &a = population[pick(rng)];
+    const Individual &b = population[pick(rng)];
+
+    if (a.front != b.front)
+        return a.front < b.front ? a : b;
+
+    return a.crowding >= b.crowding ? a : b;
+}
+
+// Whether first is no worse in any objective and better in one
+bool ParetoExplorer::dominates(const Individual &a, const Individual &b)
+{
+    bool better = false;
+    for (uint32_t o = 0; o < a.objectives.size(); o++)
+    {
+        if (a.objectives[o] > b.objectives[o])
+            return false;
+        better |= a.objectives[o] < b.objectives[o];
+    }
+
+    return better;
+}
+
+// Set front and crowding distance of every individual (fast non-dominated sort)
+void ParetoExplorer::sortFronts(std::vector<Individual> &individuals)
+{
+    uint32_t n = individuals.size();
+
+    // Individuals each one dominates, and how many dominate it
+    std::vector<std::vector<uint32_t>> dominated(n);
+    std::vector<uint32_t> dominators(n, 0);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        for (uint32_t j = 0; j < n; j++)
+        {
+            if (dominates(individuals[i], individuals[j]))
+                dominated[i].push_back(j);
+            else if (dominates(individuals[j], individuals[i]))
+                dominators[i]++;
+        }
+    }
+
+    std::vector<uint32_t> front;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (dominators[i] == 0)
+            front.push_back(i);
+    }
+
+    for (int f = 0; !front.empty(); f++)
+    {
+        // Crowding distance: sum over objectives of the gap between neighbours, boundaries
+        // are always kept
+        for (uint32_t i : front)
+        {
+            individuals[i].front = f;
+            individuals[i].crowding = 0;
+        }
+
+        for (uint32_t o = 0; o < individuals[front[0]].objectives.size(); o++)
+        {
+            std::sort(front.begin(), front.end(), [&individuals, o](uint32_t a, uint32_t b) {
+                return individuals[a].objectives[o] < individuals[b].objectives[o];
+            });
+
+            // Objectives equal across the front tell nothing apart
+            double range = individuals[front.back()].objectives[o] - individuals[front[0]].objectives[o];
+            if (!(range > 0))
+                continue;
+
+            individuals[front[0]].crowding = INFINITY;
+            individuals[front.back()].crowding = INFINITY;
+            if (std::isinf(range))
+                continue;
+
+            for (uint32_t k = 1; k + 1 < front.size(); k++)
+                individuals[front[k]].crowding +=
+                    (individuals[front[k + 1]].objectives[o] - individuals[front[k - 1]].objectives[o]) / range;
+        }
+
+        std::vector<uint32_t> next;
+        for (uint32_t i : front)
+        {
+            for (uint32_t j : dominated[i])
+            {
+                if (--dominators[j] == 0)
+                    next.push_back(j);
+            }
+        }
+        front = next;
+    }
+}
+
+// Add non-dominated individuals to frontier, dropping those they dominate
+void ParetoExplorer::updateFrontier(const std::vector<Individual> &individuals)
+{
+    for (const Individual &individual : individuals)
+    {
+        if (std::isinf(individual.objectives[0]))
+            continue;
+
+        bool covered = false;
+        for (const Individual &member : frontier)
+            covered |= dominates(member, individual) || member.objectives == individual.objectives;
+        if (covered)
+            continue;
 
-        // Add this cluster to second level clusters
-        second_level.clusters.push_back(cluster);
+        frontier.erase(std::remove_if(frontier.begin(), frontier.end(),
+                                      [&individual](const Individual &member) { return dominates(individual, member); }),
+                       frontier.end());
+        frontier.push_back(individual);
     }
+}
 
-    if (verbose)
-        std::cout << "[Lvl 2] Finished clusters creation..." << std::endl;
+// Print frontier, by first level resources (and write paretoFile)
+void ParetoExplorer::report()
+{
+    std::sort(frontier.begin(), frontier.end(), [](const Individual &a, const Individual &b) {
+        return a.objectives < b.objectives;
+    });
 
-    // Now set mobility for lvl 1 nodes
-    if (verbose)
-        std::cout << "[Lvl 1] Placing mobility models..." << std::endl;
+    std::ofstream file;
+    if (!options.paretoFile.empty())
+    {
+        file.open(options.paretoFile);
+        NS_ABORT_MSG_IF(!file.is_open(), "Couldn't write " << options.paretoFile);
 
-    for (int i = 0; i < nClusters_1st_level; i++)
+        file << "resources,secondLayerResources,secondLayerMbps,throughput,lossRate";
+        for (int c = 0; c < options.nClusters_1st_level; c++)
+            file << ",cluster" << c;
+        file << "\n";
+    }
+
+    std::cout << "Frontier (" << frontier.size() << " configurations):" << std::endl;
+    for (const Individual &individual : frontier)
     {
-        Cluster cluster = first_level.clusters[i];
+        std::cout << "  Resources " << individual.objectives[0] << ", " << rates[individual.rate]
+                  << ", throughput " << -individual.objectives[2] << " Pkt/s, loss rate "
+                  << individual.objectives[3] << std::endl;
 
-        // Configure mobility model, nodes will follow head within a certain rectangle movement
-        // We consider cleaner to use a simplier model for internal nodes movement within a head
-        // also its even easier to manage movement bounds
-        Ptr<ListPositionAllocator> subnetAlloc =
-            CreateObject<ListPositionAllocator>();
-        for (uint8_t j = 0; j < nNodes_pC_1st_level; j++)
+        if (file.is_open())
         {
-            subnetAlloc->Add(Vector(0.0, j, 0.0));
+            file << individual.objectives[0] << "," << rates[individual.rate] << "," << individual.objectives[1]
+                 << "," << -individual.objectives[2] << "," << individual.objectives[3];
+            for (double resources : individual.resources)
+                file << "," << resources;
+            file << "\n";
         }
-
-        // Nodes move around cluster's head
-        mobilityAdhoc.PushReferenceMobilityModel(cluster.headContainer.Get(0));
-        mobilityAdhoc.SetPositionAllocator(subnetAlloc);
-        mobilityAdhoc.SetMobilityModel("ns3::RandomDirection2dMobilityModel",
-                                       "Bounds", RectangleValue(Rectangle(-10, 10, -10, 10)),
-                                       "Speed", StringValue(sSpeed),
-                                       "Pause", StringValue(sPause));
-        mobilityAdhoc.Install(cluster.ns3Nodes);
     }
+}
 
-    // Config third layer only if needed
-    if (nLevels > 2)
+// Compare OLSR with hierarchical static routes over the same scenario
+// Each run happens in its own process, so memory figures are comparable
+int compareRouting(int argc, char *argv[])
+{
+    std::vector<std::string> routingModes = {"olsr", "hierarchical"};
+
+    // Both runs must share the seed
+    uint32_t seed = std::time(nullptr);
+
+    for (std::string routingMode : routingModes)
     {
-        if (nLevels == 3)
+        Taller1Experiment experiment;
+
+        double resourcesForClusters[experiment.nClusters_1st_level];
+
+        // Set minimum resource value
+        double minResourceValue = 500000;
+        double maxResourceValue = 1200000;
+
+        // Same resources for every run
+        std::srand(seed);
+        for (int j = 0; j < experiment.nClusters_1st_level; j++)
         {
-            // In a three layer architecture, there is actually one single cluster in third level
-            // And its nodes are sublayer's clusters heads
-            nClusters_3rd_level = 1;
-            nNodes_pC_3rd_level = nClusters_2nd_level;
+            resourcesForClusters[j] = ((double)rand() / (RAND_MAX)) *
+                                          (maxResourceValue - minResourceValue) +
+                                      minResourceValue;
         }
 
-        if (verbose)
-            std::cout << "Creating third level clusters..." << std::endl;
+        // Receive command line args
+        experiment.HandleCommandLineArgs(argc, argv, resourcesForClusters);
+        experiment.routingMode = routingMode;
+        if (experiment.seed == 0)
+            experiment.seed = seed;
+
+        SimulationResult experimentResult = RunInChildProcess(experiment);
+        if (!experimentResult.cached)
+            experiment.saveResult(experimentResult);
+
+        std::cout << "Routing: " << routingMode << std::endl;
+        std::cout << "Events: " << experimentResult.eventCount << std::endl;
+        std::cout << "Peak memory: " << experimentResult.memoryKb << " KiB" << std::endl;
+        std::cout << "Delivery ratio: " << experimentResult.deliveryRatio << std::endl;
+        std::cout << "Throughput: " << experimentResult.throughput << " Pkt/s" << std::endl;
+    }
 
-        for (int i = 0; i < nClusters_3rd_level; i++)
-        {
-            if (verbose)
-                std::cout << "[Lvl 3] Creating cluster #" << i << std::endl;
+    return 0;
+}
 
-            // Create cluster
-            Cluster cluster(i + nClusters_1st_level + nClusters_2nd_level);
+// Compare heads forwarding anything with heads policing and shaping members to their
+// resources, over the same scenario (each run in its own process)
+int compareAdmission(int argc, char *argv[])
+{
+    std::vector<std::string> admissionModes = {"off", "police", "shape"};
 
-            NodeContainer nodes;
+    // Every run must share the seed
+    uint32_t seed = std::time(nullptr);
 
-            // Get nodes for this cluster, they were created in previous step
-            for (int j = 0; j < nNodes_pC_3rd_level; j++)
-            {
-                // Add head as an element for cluster
-                nodes.Add(
-                    first_level.clusters[i * nNodes_pC_3rd_level * nNodes_pC_2nd_level]
-                        .ns3Nodes.Get(1));
-            }
+    for (std::string admission : admissionModes)
+    {
+        Taller1Experiment experiment;
 
-            // Set nodes in cluster
-            cluster.setNodes(nodes);
+        double resourcesForClusters[experiment.nClusters_1st_level];
 
-            // Physical layer
-            WifiHelper nodesWifi;
-            nodesWifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
-                                              "DataMode", StringValue("OfdmRate54Mbps"));
+        // Set minimum resource value
+        double minResourceValue = 500000;
+        double maxResourceValue = 1200000;
 
-            phy.SetChannel(channel.Create());
+        // Same resources for every run
+        std::srand(seed);
+        for (int j = 0; j < experiment.nClusters_1st_level; j++)
+        {
+            resourcesForClusters[j] = ((double)rand() / (RAND_MAX)) *
+                                          (maxResourceValue - minResourceValue) +
+                                      minResourceValue;
+        }
 
-            //
-            // Configure data link layer
-            //
-            WifiMacHelper nodesMac;
-            nodesMac.SetType("ns3::AdhocWifiMac");
+        // Receive command line args
+        experiment.HandleCommandLineArgs(argc, argv, resourcesForClusters);
+        experiment.admission = admission;
+        if (experiment.seed == 0)
+            experiment.seed = seed;
+
+        SimulationResult experimentResult = RunInChildProcess(experiment);
+        if (!experimentResult.cached)
+            experiment.saveResult(experimentResult);
+
+        std::cout << "Admission: " << admission << std::endl;
+        std::cout << "Goodput: " << experimentResult.stats["data.rxBytesPerSecond"] << " B/s" << std::endl;
+        std::cout << "Delivery ratio: " << experimentResult.deliveryRatio << std::endl;
+        std::cout << "Latency: mean " << experimentResult.stats["data.latencyMeanUs"] << " us, p95 "
+                  << experimentResult.stats["data.latencyP95Us"] << " us, p99 "
+                  << experimentResult.stats["data.latencyP99Us"] << " us" << std::endl;
+        std::cout << "Dropped by admission: "
+                  << experimentResult.stats["admission.memberDrops"] + experimentResult.stats["admission.aggregateDrops"]
+                  << std::endl;
+    }
 
-            // Create physical interfaces between 2nd layer nodes
-            cluster.ns3Devices = nodesWifi.Install(
-                phy, nodesMac, cluster.ns3Nodes);
+    return 0;
+}
 
-            // Note internet stack is already installed on nodes
-            Ipv4InterfaceContainer assignedAddresses = ipAddrs3rdLayer.Assign(
-                cluster.ns3Devices);
+// Compare fixed heads with heads rotating every headRotationInterval (5 s if not given),
+// over the same scenario (each run in its own process)
+int compareRotation(int argc, char *argv[])
+{
+    // Every run must share the seed
+    uint32_t seed = std::time(nullptr);
 
-            // Mobility model is already setted for heads
+    for (int rotating = 0; rotating < 2; rotating++)
+    {
+        Taller1Experiment experiment;
 
-            // Step next subnet
-            ipAddrs3rdLayer.NewNetwork();
+        double resourcesForClusters[experiment.nClusters_1st_level];
 
-            // Add this cluster to second level clusters
-            third_level.clusters.push_back(cluster);
+        // Set minimum resource value
+        double minResourceValue = 500000;
+        double maxResourceValue = 1200000;
+
+        // Same resources for every run
+        std::srand(seed);
+        for (int j = 0; j < experiment.nClusters_1st_level; j++)
+        {
+            resourcesForClusters[j] = ((double)rand() / (RAND_MAX)) *
+                                          (maxResourceValue - minResourceValue) +
+                                      minResourceValue;
         }
 
-        if (verbose)
-            std::cout << "[Lvl 3] Finished clusters creation..." << std::endl;
+        // Receive command line args
+        experiment.HandleCommandLineArgs(argc, argv, resourcesForClusters);
+        if (!rotating)
+            experiment.headRotationInterval = 0;
+        else if (experiment.headRotationInterval <= 0)
+            experiment.headRotationInterval = 5;
+        if (experiment.seed == 0)
+            experiment.seed = seed;
+
+        SimulationResult experimentResult = RunInChildProcess(experiment);
+        if (!experimentResult.cached)
+            experiment.saveResult(experimentResult);
+
+        std::cout << "Heads: " << (rotating ? "rotating" : "fixed") << std::endl;
+        std::cout << "Throughput: " << experimentResult.throughput << " Pkt/s" << std::endl;
+        std::cout << "Throughput (second half): " << experimentResult.stats["data.secondHalfThroughput"] << " Pkt/s" << std::endl;
+        std::cout << "Delivery ratio: " << experimentResult.deliveryRatio << std::endl;
+        std::cout << "Handovers: " << experimentResult.stats["rotation.handovers"] << std::endl;
+    }
 
-        if (nLevels > 3)
-        {
-            // Finally, there is a maximum of four levels in case third layer
-            // has multiple clusters
+    return 0;
+}
 
-            if (verbose)
-                std::cout << "Creating fourth level cluster..." << std::endl;
+// Compare first level clusters with 1 to gateways1 gateways (3 if not given), over the
+// same scenario, reporting throughput gained per extra gateway (each run in its own process)
+int compareGateways(int argc, char *argv[])
+{
+    // Every run must share the seed
+    uint32_t seed = std::time(nullptr);
 
-            if (verbose)
-                std::cout << "[Lvl 4] Creating cluster #0" << std::endl;
+    int maxGateways = 0;
+    double baseThroughput = 0;
 
-            // Create cluster
-            Cluster cluster(nClusters_1st_level + nClusters_2nd_level + nClusters_3rd_level);
+    for (int k = 1; maxGateways == 0 || k <= maxGateways; k++)
+    {
+        Taller1Experiment experiment;
 
-            NodeContainer nodes;
+        double resourcesForClusters[experiment.nClusters_1st_level];
 
-            // Get nodes for this cluster, they were created in previous steps
-            for (int j = 0; j < nClusters_3rd_level; j++)
-            {
-                // Add head as an element for cluster
-                nodes.Add(
-                    first_level.clusters[j * nNodes_pC_2nd_level * nNodes_pC_3rd_level]
-                        .ns3Nodes.Get(2));
-            }
+        // Set minimum resource value
+        double minResourceValue = 500000;
+        double maxResourceValue = 1200000;
 
-            // Set nodes in cluster
-            cluster.setNodes(nodes);
+        // Same resources for every run
+        std::srand(seed);
+        for (int j = 0; j < experiment.nClusters_1st_level; j++)
+        {
+            resourcesForClusters[j] = ((double)rand() / (RAND_MAX)) *
+                                          (maxResourceValue - minResourceValue) +
+                                      minResourceValue;
+        }
 
-            // Physical layer
-            WifiHelper nodesWifi;
-            nodesWifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
-                                              "DataMode", StringValue("OfdmRate54Mbps"));
+        // Receive command line args
+        experiment.HandleCommandLineArgs(argc, argv, resourcesForClusters);
+        if (maxGateways == 0)
+            maxGateways = experiment.gateways1 > 1 ? experiment.gateways1 : 3;
+        experiment.gateways1 = k;
+        if (experiment.seed == 0)
+            experiment.seed = seed;
 
-            phy.SetChannel(channel.Create());
+        SimulationResult experimentResult = RunInChildProcess(experiment);
+        if (!experimentResult.cached)
+            experiment.saveResult(experimentResult);
 
-            //
-            // Configure data link layer
-            //
-            WifiMacHelper nodesMac;
-            nodesMac.SetType("ns3::AdhocWifiMac");
+        if (k == 1)
+            baseThroughput = experimentResult.throughput;
 
-            // Create physical interfaces between 2nd layer nodes
-            cluster.ns3Devices = nodesWifi.Install(
-                phy, nodesMac, cluster.ns3Nodes);
+        std::cout << "Gateways: " << k << std::endl;
+        std::cout << "Throughput: " << experimentResult.throughput << " Pkt/s" << std::endl;
+        std::cout << "Delivery ratio: " << experimentResult.deliveryRatio << std::endl;
+        if (k > 1)
+        {
+            std::cout << "Gain per extra gateway: " << (experimentResult.throughput - baseThroughput) / (k - 1) << " Pkt/s" << std::endl;
+            std::cout << "Gateway balance: " << experimentResult.stats["gateways.lvl1.balance"] << std::endl;
+        }
+    }
 
-            // Note internet stack is already installed on nodes
-            Ipv4InterfaceContainer assignedAddresses = ipAddrs4thLayer.Assign(
-                cluster.ns3Devices);
+    return 0;
+}
 
-            // Mobility model is already setted for heads
+// Estimate how resources must grow with size for each level count (see GrowthEstimator)
+int estimateGrowth(int argc, char *argv[])
+{
+    GrowthEstimator estimator(argc, argv);
+    estimator.run();
+    estimator.report();
 
-            // Add this cluster to second level clusters
-            fourth_level.clusters.push_back(cluster);
+    return 0;
+}
 
-            if (verbose)
-                std::cout << "[Lvl 4] Finished clusters creation..." << std::endl;
-        }
-    }
+// Explore trade-offs of resources, rates, throughput and loss (see ParetoExplorer)
+int explorePareto(int argc, char *argv[])
+{
+    ParetoExplorer explorer(argc, argv);
+    explorer.run();
+    explorer.report();
 
-    // Preparate nodes for simulation
-    if (verbose)
-        std::cout << "Preparing random traffic for simulation..." << std::endl;
+    return 0;
+}
+
+// Lookup microbenchmark: PrefixTrie against a linear scan like the one
+// Ipv4StaticRouting does (every route checked, longest match kept)
+int benchmarkLookup(int argc, char *argv[])
+{
+    std::vector<uint32_t> tableSizes = {1000, 10000, 100000};
+    uint32_t nLookups = 1000000;
+    std::mt19937 rng(1);
 
-    // Make k random connections between nodes in first level
-    int k = 20;
-    for (int i = 0; i < k; i++)
+    for (uint32_t n : tableSizes)
     {
-        int senderNodeIndex = rand() % nNodes_pC_1st_level;
-        int receiverNodeIndex = rand() % nNodes_pC_1st_level;
+        // Random prefixes, lengths similar to cluster networks
+        std::vector<uint32_t> networks(n), masks(n);
+        std::vector<uint8_t> lengths(n);
+        PrefixTrie trie;
 
-        int senderClusterIndex = rand() % nClusters_1st_level;
-        int receiverClusterIndex = rand() % nClusters_1st_level;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            lengths[i] = 16 + rng() % 15;
+            masks[i] = 0xffffffff << (32 - lengths[i]);
+            networks[i] = rng() & masks[i];
+            trie.insert(networks[i], lengths[i], i);
+        }
 
-        while (senderNodeIndex == receiverNodeIndex && receiverClusterIndex == senderClusterIndex)
+        // Half of destinations fall inside a known network
+        std::vector<uint32_t> destinations(nLookups);
+        for (uint32_t i = 0; i < nLookups; i++)
         {
-            receiverNodeIndex = rand() % nNodes_pC_1st_level;
-            receiverClusterIndex = rand() % nClusters_1st_level;
+            uint32_t k = rng() % n;
+            destinations[i] = i % 2 == 0 ? networks[k] | (rng() & ~masks[k]) : rng();
         }
 
-        if (verbose)
-            std::cout << "Connecting IP Address: "
-                      << first_level.clusters[senderClusterIndex].nodes[senderNodeIndex].node->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal()
-                      << " with IP Address: "
-                      << first_level.clusters[receiverClusterIndex].nodes[receiverNodeIndex].node->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal()
-                      << std::endl;
+        std::vector<uint32_t> trieResults(nLookups, UINT32_MAX);
 
-        ClusterNode senderNode = first_level.clusters[senderClusterIndex].nodes[senderNodeIndex];
-        ClusterNode receiverNode = first_level.clusters[receiverClusterIndex].nodes[receiverNodeIndex];
-        senderNode.connectWithNode(receiverNode, this);
-    }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < nLookups; i++)
+            trie.lookup(destinations[i], trieResults[i]);
+        double trieNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / nLookups;
 
-    if (verbose)
-        std::cout << "Running simulation..." << std::endl;
+        // Linear scans are way slower, so they take fewer lookups
+        uint32_t nLinear = std::min(nLookups, std::max<uint32_t>(1000, 100000000 / n));
+        uint32_t mismatches = 0;
 
-    // Run simulation
-    Simulator::Stop(Seconds(simulationTime));
-    Simulator::Run();
+        start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < nLinear; i++)
+        {
+            int best = -1;
 
-    std::cout << "Simulation finished" << std::endl;
-    std::cout << "Level of resources in first layer: " << first_level.getResources() << std::endl;
+            for (uint32_t j = 0; j < n; j++)
+            {
+                if ((destinations[i] & masks[j]) == networks[j] && (best < 0 || lengths[j] >= lengths[best]))
+                    best = j;
+            }
 
-    // Show performance results
-    std::cout << "Total packets received: " << receivedCount << std::endl;
-    std::cout << "Total packets sent: " << sentCount << std::endl;
-    double throughput = receivedCount / Simulator::Now().GetSeconds(); // Pkt / s
-    double lossRate = (sentCount - receivedCount) / (double)sentCount;
+            // Same networks inserted twice keep the last value on both sides
+            uint32_t expected = best < 0 ? UINT32_MAX : best;
+            if (trieResults[i] != expected && (best < 0 || trieResults[i] == UINT32_MAX ||
+                                               networks[trieResults[i]] != networks[best] ||
+                                               lengths[trieResults[i]] != lengths[best]))
+                mismatches++;
+        }
+        double linearNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / nLinear;
 
-    // Generate simulation results data container
-    SimulationResult results;
-    results.throughput = throughput;
-    results.lossRate = lossRate;
+        std::cout << "Routes: " << n << std::endl;
+        std::cout << "Trie lookup: " << trieNs << " ns" << std::endl;
+        std::cout << "Linear lookup: " << linearNs << " ns" << std::endl;
+        std::cout << "Mismatches: " << mismatches << std::endl;
+    }
 
-    Simulator::Destroy();
+    return 0;
+}
 
-    return results;
+// Write resultsFile as CSV
+int exportResults(Taller1Experiment &experiment)
+{
+    NS_ABORT_MSG_IF(experiment.resultsFile.empty(), "exportResults needs --resultsFile");
+
+    ResultStore(experiment.resultsFile).exportCsv(experiment.csvFile);
+    std::cout << "Results written to " << experiment.csvFile << std::endl;
+
+    return 0;
 }
 
 // Useful for resources testing
+// With --journalFile cases run in child processes and the sweep can be resumed
 int testPhyRatio(int argc, char *argv[])
 {
     // Time::SetResolution(Time::US);
     int ncases = 50;
+
+    std::unique_ptr<SweepJournal> journal;
+    std::set<uint32_t> savedCases;
+    std::set<std::string> detailedRuns;
+    {
+        Taller1Experiment options;
+        std::vector<double> resources(options.nClusters_1st_level);
+        options.HandleCommandLineArgs(argc, argv, resources.data());
+
+        if (!options.journalFile.empty())
+        {
+            journal.reset(new SweepJournal(options.journalFile));
+
+            // Cases of this sweep already in results file
+            if (!options.resultsFile.empty() && !journal->done.empty())
+            {
+                ResultTable table = ResultStore(options.resultsFile).load();
+                std::vector<std::string> &ids = table.texts["sweep.id"];
+                std::vector<double> &cases = table.numbers["sweep.case"];
+                ids.resize(table.nRows);
+                cases.resize(table.nRows, NAN);
+
+                for (uint64_t r = 0; r < table.nRows; r++)
+                {
+                    if (ids[r] == journal->sweepId && !std::isnan(cases[r]))
+                        savedCases.insert((uint32_t)cases[r]);
+                }
+
+                // Details are appended first, they may be there for cases that aren't
+                detailedRuns = ResultStore(options.resultsFile + ".details").runIds();
+            }
+        }
+    }
+
+    // Cases are appended in groups (a resumed journal saves again cases a crash lost)
+    std::unique_ptr<ResultStore> results, details;
+
     // Create experiment
     for (int i = 0; i < ncases; i++)
     {
@@ -1069,10 +8581,70 @@ int testPhyRatio(int argc, char *argv[])
 
         // Receive command line args
         experiment.HandleCommandLineArgs(argc, argv, resourcesForClusters);
+        if (!results)
+        {
+            results.reset(new ResultStore(experiment.resultsFile));
+            details.reset(new ResultStore(experiment.resultsFile + ".details"));
+            results->attachDetails(*details);
+        }
 
         // Run experiment
         std::cout << "Case " << i << std::endl;
-        SimulationResult experimentResult = experiment.Run();
+        SimulationResult experimentResult;
+
+        if (journal)
+        {
+            // Planned cases keep their parameters (seed, then resources)
+            if (journal->planned.count(i))
+            {
+                std::vector<double> &values = journal->planned[i];
+                experiment.seed = (uint32_t)values[0];
+                experiment.firstLayerResources.assign(values.begin() + 1, values.end());
+            }
+            else
+            {
+                if (experiment.seed == 0)
+                    experiment.seed = std::time(nullptr);
+                experiment.seed += i;
+
+                std::vector<double> values = {(double)experiment.seed};
+                values.insert(values.end(), experiment.firstLayerResources.begin(), experiment.firstLayerResources.end());
+                journal->plan(i, values);
+            }
+
+            // Finished cases are saved with the parameters they ran with
+            experiment.normalize();
+
+            if (journal->done.count(i))
+                experimentResult = journal->done[i];
+            else
+            {
+                experimentResult = RunInChildProcess(experiment);
+                NS_ABORT_MSG_IF(experimentResult.failed, "Case " << i << " failed, run again to resume");
+                journal->complete(i, experimentResult);
+            }
+
+            // Results are saved after the journal, a crash in between is fixed on resume
+            if (!experiment.resultsFile.empty() && !savedCases.count(i))
+            {
+                ResultRow row = experiment.describe(experimentResult);
+                row.texts["sweep.id"] = journal->sweepId;
+                row.numbers["sweep.case"] = i;
+                results->add(row);
+                if (!detailedRuns.count(experiment.configKey()))
+                {
+                    for (const ResultRow &detail : experiment.details(experimentResult))
+                        details->add(detail);
+                }
+            }
+        }
+        else
+        {
+            experimentResult = experiment.RunCached();
+            if (!experimentResult.cached)
+                experiment.saveResult(experimentResult, *results, *details);
+        }
+
         std::cout << "Resources: " << std::endl;
 
         for (int i = 0; i < (int)experiment.firstLayerResources.size(); i++)
@@ -1108,8 +8680,30 @@ int main(int argc, char **argv)
     // Receive command line args
     experiment.HandleCommandLineArgs(argc, argv, resourcesForClusters);
 
+    // Other modes run their own experiments
+    if (experiment.mode == "testPhyRatio")
+        return testPhyRatio(argc, argv);
+    if (experiment.mode == "compareRouting")
+        return compareRouting(argc, argv);
+    if (experiment.mode == "compareAdmission")
+        return compareAdmission(argc, argv);
+    if (experiment.mode == "compareRotation")
+        return compareRotation(argc, argv);
+    if (experiment.mode == "compareGateways")
+        return compareGateways(argc, argv);
+    if (experiment.mode == "estimateGrowth")
+        return estimateGrowth(argc, argv);
+    if (experiment.mode == "explorePareto")
+        return explorePareto(argc, argv);
+    if (experiment.mode == "benchmarkLookup")
+        return benchmarkLookup(argc, argv);
+    if (experiment.mode == "exportResults")
+        return exportResults(experiment);
+
     // Run experiment
-    SimulationResult experimentResult = experiment.Run();
+    SimulationResult experimentResult = experiment.RunCached();
+    if (!experimentResult.cached)
+        experiment.saveResult(experimentResult);
     std::cout << "Resources: " << std::endl;
 
     for (int i = 0; i < (int)experiment.firstLayerResources.size(); i++)